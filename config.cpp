@@ -24,6 +24,22 @@
 #include "usbfs.hpp"
 
 
+/* Local functions. */
+
+/*
+ * compile_formats - turns the date and time formats into something quicker
+ *                   to render; rendering happens far more often than reading
+ *                   the configuration!
+ */
+
+static void config_compile_formats( uc_config_t *p_config )
+{
+  format_compile( p_config->date_format, '/', p_config->language, &p_config->date_program );
+  format_compile( p_config->time_format, ':', p_config->language, &p_config->time_program );
+  return;
+}
+
+
 /* Functions.*/
 
 /*
@@ -46,6 +62,11 @@ uint32_t  config_read( uc_config_t *p_config )
   strcpy( p_config->ntp_server, "pool.ntp.org" );
   p_config->utc_offset_minutes = 0;
   strcpy( p_config->date_format, "dmy" );
+  strcpy( p_config->time_format, "HMS" );
+  strcpy( p_config->language, "en" );
+  p_config->timezone[0] = '\0';
+  p_config->animate = false;
+  strcpy( p_config->face, "standard" );
 
   /* Try to open up the file. */
   usb_debug( "Reading configuration file %s", UC_CONFIG_FILENAME );
@@ -92,14 +113,45 @@ uint32_t  config_read( uc_config_t *p_config )
         p_config->date_format[UC_DATE_FORMAT_MAXLEN] = '\0';
         usb_debug( "Setting DATE_FORMAT to %s", p_config->date_format );
       }
+      if ( strncmp( l_buffer, "TIME_FORMAT: ", 13 ) == 0 )
+      {
+        strncpy( p_config->time_format, l_buffer+13, UC_TIME_FORMAT_MAXLEN );
+        p_config->time_format[UC_TIME_FORMAT_MAXLEN] = '\0';
+        usb_debug( "Setting TIME_FORMAT to %s", p_config->time_format );
+      }
+      if ( strncmp( l_buffer, "LANGUAGE: ", 10 ) == 0 )
+      {
+        strncpy( p_config->language, l_buffer+10, UC_LANGUAGE_MAXLEN );
+        p_config->language[UC_LANGUAGE_MAXLEN] = '\0';
+        usb_debug( "Setting LANGUAGE to %s", p_config->language );
+      }
+      if ( strncmp( l_buffer, "TIMEZONE: ", 10 ) == 0 )
+      {
+        strncpy( p_config->timezone, l_buffer+10, UC_TIMEZONE_MAXLEN );
+        p_config->timezone[UC_TIMEZONE_MAXLEN] = '\0';
+        usb_debug( "Setting TIMEZONE to %s", p_config->timezone );
+      }
+      if ( strncmp( l_buffer, "ANIMATION: ", 11 ) == 0 )
+      {
+        p_config->animate = ( strcmp( l_buffer+11, "roll" ) == 0 );
+        usb_debug( "Setting ANIMATION to %s", p_config->animate ? "roll" : "none" );
+      }
+      if ( strncmp( l_buffer, "FACE: ", 6 ) == 0 )
+      {
+        strncpy( p_config->face, l_buffer+6, UC_FACE_MAXLEN );
+        p_config->face[UC_FACE_MAXLEN] = '\0';
+        usb_debug( "Setting FACE to %s", p_config->face );
+      }
     }
 
     /* All done. */
     f_close( &l_fptr );
+    config_compile_formats( p_config );
   }
   else
   {
     /* Just write the defaults into the file, then. */
+    config_compile_formats( p_config );
     if ( !config_write( p_config ) )
     {
       ufs_unmount();
@@ -153,6 +205,16 @@ bool config_write( const uc_config_t *p_config )
   f_puts( l_buffer, &l_fptr );
   snprintf( l_buffer, 127, "DATE_FORMAT: %s\n", p_config->date_format );
   f_puts( l_buffer, &l_fptr );
+  snprintf( l_buffer, 127, "TIME_FORMAT: %s\n", p_config->time_format );
+  f_puts( l_buffer, &l_fptr );
+  snprintf( l_buffer, 127, "LANGUAGE: %s\n", p_config->language );
+  f_puts( l_buffer, &l_fptr );
+  snprintf( l_buffer, 127, "TIMEZONE: %s\n", p_config->timezone );
+  f_puts( l_buffer, &l_fptr );
+  snprintf( l_buffer, 127, "ANIMATION: %s\n", p_config->animate ? "roll" : "none" );
+  f_puts( l_buffer, &l_fptr );
+  snprintf( l_buffer, 127, "FACE: %s\n", p_config->face );
+  f_puts( l_buffer, &l_fptr );
 
   /* Close it up. */
   f_close( &l_fptr );
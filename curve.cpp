@@ -0,0 +1,320 @@
+/*
+ * curve.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * The brightness curve; this maps the ambient light level onto the (perceived)
+ * brightness the display should be at. It starts off as a simple straight
+ * line, but every time the user adjusts the brightness we bend the curve to
+ * suit, so that it learns what the user likes in their particular room.
+ * 
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+#include "usbfs.hpp"
+
+
+/* Module variables. */
+
+typedef struct
+{
+  uint32_t  magic;
+  uint8_t   version;
+  uint8_t   points;
+  uint8_t   levels[UC_CURVE_POINTS];
+  uint8_t   checksum;
+} uc_curve_record_t;
+
+static uint8_t          m_curve_levels[UC_CURVE_POINTS];
+static uint8_t          m_curve_lut[UC_CURVE_LUT_SIZE];
+static bool             m_curve_dirty;
+static absolute_time_t  m_curve_save;
+
+
+/* Local functions. */
+
+/*
+ * checksum - works out a simple checksum over a curve record, so that we can
+ *            spot a damaged file.
+ */
+
+static uint8_t curve_checksum( const uc_curve_record_t *p_record )
+{
+  const uint8_t  *l_byte = (const uint8_t *)p_record;
+  uint8_t         l_sum = 0;
+  uint_fast8_t    l_index;
+
+  /* Add up everything before the checksum itself. */
+  for ( l_index = 0; l_index < offsetof( uc_curve_record_t, checksum ); l_index++ )
+  {
+    l_sum = ( l_sum << 1 | l_sum >> 7 ) ^ l_byte[l_index];
+  }
+
+  /* All done. */
+  return l_sum;
+}
+
+
+/*
+ * evaluate - works out the level for an ambient light level, by interpolating
+ *            between the points either side of it.
+ */
+
+static int curve_evaluate( uint16_t p_ambient )
+{
+  uint_fast8_t  l_point;
+  int           l_offset;
+
+  /* Find the point below us, and how far past it we are. */
+  l_point = p_ambient / UC_CURVE_SPACING;
+  l_offset = p_ambient % UC_CURVE_SPACING;
+  if ( l_point >= UC_CURVE_POINTS - 1 )
+  {
+    return m_curve_levels[UC_CURVE_POINTS-1];
+  }
+
+  /* And interpolate. */
+  return m_curve_levels[l_point] + 
+         ( ( m_curve_levels[l_point+1] - m_curve_levels[l_point] ) * l_offset ) / UC_CURVE_SPACING;
+}
+
+
+/*
+ * build_lut - fills in the lookup table from the current curve.
+ */
+
+static void curve_build_lut( void )
+{
+  uint_fast8_t  l_index;
+
+  /* Each entry is the curve at the middle of its range of light levels. */
+  for ( l_index = 0; l_index < UC_CURVE_LUT_SIZE; l_index++ )
+  {
+    m_curve_lut[l_index] = curve_evaluate( ( ( l_index * 2 + 1 ) * UC_LIGHT_LEVELS ) / ( UC_CURVE_LUT_SIZE * 2 ) );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * save - writes the current curve out to the filesystem.
+ */
+
+static bool curve_save( void )
+{
+  FIL                 l_fptr;
+  FRESULT             l_result;
+  uc_curve_record_t   l_record;
+  UINT                l_written;
+
+  /* Fill in the record. */
+  memset( &l_record, 0, sizeof( l_record ) );
+  l_record.magic = UC_CURVE_MAGIC;
+  l_record.version = UC_CURVE_VERSION;
+  l_record.points = UC_CURVE_POINTS;
+  memcpy( l_record.levels, m_curve_levels, UC_CURVE_POINTS );
+  l_record.checksum = curve_checksum( &l_record );
+
+  /* And write it out, in one go. */
+  ufs_mount();
+  l_result = f_open( &l_fptr, UC_CURVE_FILENAME, FA_CREATE_ALWAYS | FA_WRITE );
+  if ( l_result != FR_OK )
+  {
+    ufs_unmount();
+    return false;
+  }
+  l_result = f_write( &l_fptr, &l_record, sizeof( l_record ), &l_written );
+  f_close( &l_fptr );
+  ufs_unmount();
+  usb_fs_changed();
+
+  /* All done. */
+  return ( l_result == FR_OK ) && ( l_written == sizeof( l_record ) );
+}
+
+
+/* Functions.*/
+
+/*
+ * init - loads the curve from the filesystem if we've saved one, or sets up
+ *        a sensible default if not.
+ */
+
+void curve_init( void )
+{
+  FIL                 l_fptr;
+  FRESULT             l_result;
+  uc_curve_record_t   l_record;
+  UINT                l_read = 0;
+  uint_fast8_t        l_index;
+  int                 l_level;
+
+  /* Start with the default; brighter in proportion to the ambient light. */
+  for ( l_index = 0; l_index < UC_CURVE_POINTS; l_index++ )
+  {
+    l_level = ( ( ( l_index * UC_CURVE_SPACING ) + 512 ) * ( UC_BRIGHTNESS_LEVELS - 1 ) ) / 4096;
+    if ( l_level < UC_BRIGHTNESS_FLOOR )
+    {
+      l_level = UC_BRIGHTNESS_FLOOR;
+    }
+    if ( l_level > UC_BRIGHTNESS_LEVELS - 1 )
+    {
+      l_level = UC_BRIGHTNESS_LEVELS - 1;
+    }
+    m_curve_levels[l_index] = l_level;
+  }
+
+  /* Then see if we have a saved one. */
+  ufs_mount();
+  l_result = f_open( &l_fptr, UC_CURVE_FILENAME, FA_READ );
+  if ( l_result == FR_OK )
+  {
+    l_result = f_read( &l_fptr, &l_record, sizeof( l_record ), &l_read );
+    f_close( &l_fptr );
+  }
+  ufs_unmount();
+
+  /* Only use it if it looks entirely sane. */
+  if ( ( l_result == FR_OK ) && ( l_read == sizeof( l_record ) ) &&
+       ( l_record.magic == UC_CURVE_MAGIC ) && ( l_record.version == UC_CURVE_VERSION ) &&
+       ( l_record.points == UC_CURVE_POINTS ) && 
+       ( l_record.checksum == curve_checksum( &l_record ) ) )
+  {
+    usb_debug( "Loaded brightness curve from %s", UC_CURVE_FILENAME );
+    memcpy( m_curve_levels, l_record.levels, UC_CURVE_POINTS );
+  }
+
+  /* Build the lookup table, and we're ready to go. */
+  curve_build_lut();
+  m_curve_dirty = false;
+  return;
+}
+
+
+/*
+ * level - returns the perceived brightness level for the ambient light.
+ */
+
+uint8_t curve_level( uint16_t p_ambient )
+{
+  return m_curve_lut[( p_ambient * UC_CURVE_LUT_SIZE ) / UC_LIGHT_LEVELS];
+}
+
+
+/*
+ * adjust - the user has asked for the display to be brighter (or dimmer) at
+ *          this ambient light level, so we bend the curve to suit. The two
+ *          points either side take a share of the change in proportion to
+ *          how close they are, and the rest of the curve is then nudged to
+ *          make sure it never gets dimmer as the room gets lighter.
+ */
+
+void curve_adjust( uint16_t p_ambient, int p_change )
+{
+  uint_fast8_t  l_point, l_index;
+  int           l_current, l_target, l_level;
+  float         l_weight, l_spread;
+
+  /* Work out where we are now, and where we want to be. */
+  l_current = curve_evaluate( p_ambient );
+  l_target = l_current + p_change;
+  if ( l_target < UC_BRIGHTNESS_FLOOR )
+  {
+    l_target = UC_BRIGHTNESS_FLOOR;
+  }
+  if ( l_target > UC_BRIGHTNESS_LEVELS - 1 )
+  {
+    l_target = UC_BRIGHTNESS_LEVELS - 1;
+  }
+
+  /* Share out the change between the points either side. */
+  l_point = p_ambient / UC_CURVE_SPACING;
+  if ( l_point >= UC_CURVE_POINTS - 1 )
+  {
+    m_curve_levels[UC_CURVE_POINTS-1] = l_target;
+  }
+  else
+  {
+    /* Scale it up so that the interpolated value lands on the target. */
+    l_weight = (float)( p_ambient % UC_CURVE_SPACING ) / UC_CURVE_SPACING;
+    l_spread = ( l_weight * l_weight ) + ( ( 1.0f - l_weight ) * ( 1.0f - l_weight ) );
+    for ( l_index = 0; l_index < 2; l_index++ )
+    {
+      l_level = m_curve_levels[l_point+l_index] + 
+                ( ( l_index ? l_weight : 1.0f - l_weight ) * ( l_target - l_current ) ) / l_spread;
+      if ( l_level < UC_BRIGHTNESS_FLOOR )
+      {
+        l_level = UC_BRIGHTNESS_FLOOR;
+      }
+      if ( l_level > UC_BRIGHTNESS_LEVELS - 1 )
+      {
+        l_level = UC_BRIGHTNESS_LEVELS - 1;
+      }
+      m_curve_levels[l_point+l_index] = l_level;
+    }
+  }
+
+  /* Keep the curve rising, pushing neighbours out of the way if required. */
+  for ( l_index = l_point + 1; l_index < UC_CURVE_POINTS; l_index++ )
+  {
+    if ( m_curve_levels[l_index] < m_curve_levels[l_index-1] )
+    {
+      m_curve_levels[l_index] = m_curve_levels[l_index-1];
+    }
+  }
+  for ( l_index = l_point; l_index > 0; l_index-- )
+  {
+    if ( m_curve_levels[l_index-1] > m_curve_levels[l_index] )
+    {
+      m_curve_levels[l_index-1] = m_curve_levels[l_index];
+    }
+  }
+
+  /* Rebuild the lookup, and save it once the user has stopped fiddling. */
+  curve_build_lut();
+  m_curve_dirty = true;
+  m_curve_save = make_timeout_time_ms( UC_CURVE_SAVE_MS );
+  return;
+}
+
+
+/*
+ * update - called regularly, to save any changes to the curve once they've
+ *          settled down; we don't want to write to flash on every press.
+ */
+
+void curve_update( void )
+{
+  /* Only when there's something to save, and we've waited long enough. */
+  if ( m_curve_dirty && time_reached( m_curve_save ) )
+  {
+    if ( curve_save() )
+    {
+      usb_debug( "Saved brightness curve to %s", UC_CURVE_FILENAME );
+    }
+    m_curve_dirty = false;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file curve.cpp */
@@ -6,7 +6,12 @@
  *
  * Here is where we do all the work to draw on the display; all the drawing
  * is done on the provided PicoGraphics object - it's the caller's responsibility
- * to hand that off to the Unicorn itself.
+ * to hand that off to the Unicorn itself. Faces draw onto a layer of their
+ * own, and overlays like the brightness bar sit on layers above that; each
+ * frame is composed from them, only where something has changed.
+ *
+ * All of this runs on core1, driven by render.cpp; the exception is picking
+ * the next face, which only touches the configuration.
  * 
  * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
  * Released under the MIT License; see LICENSE for details.
@@ -14,325 +19,494 @@
 
 /* System headers. */
 
+#include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "hardware/rtc.h"
+#include "pico/stdlib.h"
 
 /* Local headers. */
 
 #include "uniclock.h"
 #include "usbfs.hpp"
 #include "libraries/pico_graphics/pico_graphics.hpp"
-#include "libraries/galactic_unicorn/galactic_unicorn.hpp"
 #include "clockfont_data.hpp"
 
 
 /* Module variables. */
 
 static pimoroni::PicoGraphics    *m_graphics;
-static pimoroni::GalacticUnicorn *m_unicorn;
+static uc_unicorn_t              *m_unicorn;
 static int                        m_black_pen, m_white_pen;
-static float                      m_base_brightness;
-static uint_fast8_t               m_brightness_display, m_mode_timer;
-static uc_display_mode_t          m_display_mode;
+static bool                       m_brightness_display, m_face_expired;
+static uc_timer_t                 m_timers[UC_TIMERS];
+static uint_fast8_t               m_timer_count;
+static const uc_face_t           *m_face, *m_drawn_face;
+static uint_fast8_t               m_clock_face;
+static int                        m_gradient_pens[UC_PANEL_WIDTH];
+static uint32_t                   m_pen_keys[UC_PEN_CACHE_SIZE];
+static int                        m_pen_values[UC_PEN_CACHE_SIZE];
+static uint32_t                   m_pen_hits, m_pen_misses;
+static int                        m_gradient_bucket;
+static bool                       m_palette_changed;
+static bool                       m_frame_valid, m_drawn_blink;
+static char                       m_drawn_text[UC_TEXT_MAXLEN+1];
+static int32_t                    m_drawn_key, m_drawn_origin;
+static uc_layout_t                m_layouts[UC_LAYOUT_CACHE_SIZE];
+static uint_fast8_t               m_layout_next;
+static int                        m_drawn_pens[UC_PANEL_WIDTH];
+static uc_pixel_t                 m_base[UC_PANEL_WIDTH*UC_PANEL_HEIGHT];
+static uc_rect_t                  m_damage, m_output_damage;
+static bool                       m_push_all, m_push_lit;
+static uc_layer_t                 m_layers[UC_LAYERS];
+static uint32_t                   m_frame_pixels, m_total_pixels;
+static uint32_t                   m_frames_rendered, m_frames_pushed;
+static uint8_t                    m_glyph_rows[UC_ATLAS_GLYPHS][UC_GLYPH_HEIGHT];
+static uint8_t                    m_glyph_widths[UC_ATLAS_GLYPHS];
+static char                       m_roll_from[16];
+static uint32_t                   m_roll_cells;
+static uint64_t                   m_roll_start_us[16];
+static bool                       m_frame_animated, m_animation_suspended;
+static uint_fast8_t               m_frame_overruns;
+static absolute_time_t            m_animation_resume;
+static uint32_t                   m_worst_frame_us;
+static char                       m_marquee_text[UC_MARQUEE_MAXLEN+1];
+static uint8_t                    m_marquee_columns[UC_MARQUEE_MAXCOLS];
+static uint_fast16_t              m_marquee_length;
+static uint64_t                   m_marquee_start_us;
+static bool                       m_marquee_active, m_marquee_scrolling;
+static int                        m_marquee_pens[UC_MARQUEE_SUBSTEPS+1];
+static uint32_t                   m_brightness_lut[UC_BRIGHTNESS_LEVELS];
+static uint32_t                   m_brightness_target;
+static uint32_t                   m_brightness_level, m_brightness_level_target;
+static uint_fast16_t              m_brightness_step;
+static uint_fast8_t               m_dither_error;
+static bool                       m_dithering;
 
 
 /* Local functions. */
 
+/*
+ * cos_q15 - integer cosine lookup. The angle is given in UC_ANGLE_STEPS per
+ *           full turn, and the result is scaled so that 1.0 is 32768. We only
+ *           store a quarter wave, interpolating between the table entries.
+ */
+
+static int32_t display_cos_q15( uint32_t p_angle )
+{
+  static const uint16_t l_cos_table[65] = {
+    32767, 32758, 32729, 32679, 32610, 32522, 32413, 32286,
+    32138, 31972, 31786, 31581, 31357, 31114, 30853, 30572,
+    30274, 29957, 29622, 29269, 28899, 28511, 28106, 27684,
+    27246, 26791, 26320, 25833, 25330, 24812, 24279, 23732,
+    23170, 22595, 22006, 21403, 20788, 20160, 19520, 18868,
+    18205, 17531, 16846, 16151, 15447, 14733, 14010, 13279,
+    12540, 11793, 11039, 10279,  9512,  8740,  7962,  7180,
+     6393,  5602,  4808,  4011,  3212,  2411,  1608,   804,
+        0
+  };
+  uint32_t      l_quadrant, l_index, l_entry, l_fraction;
+  int32_t       l_value;
+
+  /* Split the angle into the quadrant, and the position within it. */
+  p_angle %= UC_ANGLE_STEPS;
+  l_quadrant = p_angle / ( UC_ANGLE_STEPS / 4 );
+  l_index = p_angle % ( UC_ANGLE_STEPS / 4 );
+
+  /* The odd quadrants run the quarter wave backwards. */
+  if ( l_quadrant & 1 )
+  {
+    l_index = ( UC_ANGLE_STEPS / 4 ) - l_index;
+  }
+
+  /* Look up the surrounding table entries, and interpolate between them. */
+  l_entry = l_index / ( UC_ANGLE_STEPS / 256 );
+  l_fraction = l_index % ( UC_ANGLE_STEPS / 256 );
+  l_value = l_cos_table[l_entry];
+  if ( l_fraction > 0 )
+  {
+    l_value -= ( ( l_cos_table[l_entry] - l_cos_table[l_entry+1] ) * l_fraction ) 
+               / ( UC_ANGLE_STEPS / 256 );
+  }
+
+  /* And the middle two quadrants are negative. */
+  if ( ( l_quadrant == 1 ) || ( l_quadrant == 2 ) )
+  {
+    return -l_value;
+  }
+  return l_value;
+}
+
+
 /*
  * calc_midday_percent - works out the percentage to midday, which is used
- *                       to configure the colours shown.
+ *                       to configure the colours shown. This is returned in
+ *                       steps of 1/UC_GRADIENT_STEPS, and is all done with
+ *                       integers because the RP2040 has no FPU.
  */
 
-static float display_calc_midday_percent( datetime_t *p_datetime )
+static uint_fast16_t display_calc_midday_percent( const datetime_t *p_datetime )
 {
-  uint_fast16_t   l_secs_in_day;
-  float           l_day_percent, l_midday_percent;
+  uint32_t        l_secs_in_day, l_angle;
+  int32_t         l_midday_q16;
 
   /* Work out how many seconds through the day we are. */
   l_secs_in_day = ( ( ( p_datetime->hour * 60 ) + p_datetime->min ) * 60 ) + p_datetime->sec;
 
-  /* Calculate what percent of the day that represents. */
-  l_day_percent = l_secs_in_day / 86400.0f;
+  /* Calculate what angle around the day that represents. */
+  l_angle = ( (uint64_t)l_secs_in_day * UC_ANGLE_STEPS ) / 86400;
 
-  /* And finally, translate that to how close to midday we are. */
-  l_midday_percent = 1.0f - ( ( cos( l_day_percent * 3.14159 * 2 ) + 1 ) / 2 );
+  /*
+   * And translate that to how close to midday we are; 1 - ( ( cos + 1 ) / 2 ),
+   * which is just 1 - cos if we treat it as Q16 rather than Q15.
+   */
+  l_midday_q16 = 32768 - display_cos_q15( l_angle );
+
+  /* All done! Just scale it into gradient steps, truncating as a float would. */
+  return ( l_midday_q16 * UC_GRADIENT_STEPS ) >> 16;
+}
+
+
+/*
+ * intern_pen - returns a pen for the given colour, only asking PicoGraphics
+ *              to create one if we haven't seen the colour recently. Colours
+ *              are hashed into a small table, with a short linear probe; if
+ *              that's all full, the colour simply takes over its home slot.
+ *
+ *              With a palette, an evicted pen would keep its entry for good,
+ *              so there the table has room for every entry and the probe
+ *              covers all of it; nothing is ever evicted, and once the
+ *              palette is full we return -1 without remembering it.
+ */
+
+int display_intern_pen( uint8_t p_red, uint8_t p_green, uint8_t p_blue )
+{
+  uint32_t        l_key, l_home, l_slot;
+  uint_fast16_t   l_probe;
+  int             l_pen;
+
+  /* The key is the colour, with a top bit to mark the slot as in use. */
+  l_key = 0x01000000 | ( p_red << 16 ) | ( p_green << 8 ) | p_blue;
+  l_home = ( l_key * 2654435761u ) >> ( 32 - UC_PEN_CACHE_BITS );
+
+  /* Look for it, or an empty slot to put it in. */
+  for ( l_probe = 0; l_probe < UC_PEN_CACHE_PROBES; l_probe++ )
+  {
+    l_slot = ( l_home + l_probe ) & ( UC_PEN_CACHE_SIZE - 1 );
+    if ( m_pen_keys[l_slot] == l_key )
+    {
+      m_pen_hits++;
+      return m_pen_values[l_slot];
+    }
+    if ( m_pen_keys[l_slot] == 0 )
+    {
+      break;
+    }
+  }
 
-  /* All done! */
-  return l_midday_percent;
+  /* Not found, so create it; it goes in the empty slot, or its home one. */
+  if ( l_probe == UC_PEN_CACHE_PROBES )
+  {
+    l_slot = l_home;
+  }
+  m_pen_misses++;
+  l_pen = m_graphics->create_pen( p_red, p_green, p_blue );
+  if ( l_pen < 0 )
+  {
+    return l_pen;
+  }
+  m_pen_keys[l_slot] = l_key;
+  m_pen_values[l_slot] = l_pen;
+  return l_pen;
 }
 
 
 /*
  * create_gradient_pen - creates a pen with a suitable gradient colour, based
  *                       on the midday percentage and the column.
+ *
+ *                       This is a fixed point version of Pimoroni's HSV to RGB
+ *                       conversion; hue is held in 1/2^24ths of a sextant,
+ *                       saturation is Q16 and value is Q16 on a 0-255 scale.
+ *                       That's enough precision to give exactly the same
+ *                       colours as the float version, which the self test
+ *                       checks.
  */
 
-static int create_gradient_pen( float p_midday_percent, int p_column )
+static uint32_t display_gradient_colour( uint_fast16_t p_midday_percent, int p_column )
 {
-  int           l_center_proximity, l_midpoint;
-  float         l_hue, l_sat, l_val;
-  uint_fast8_t  l_red, l_green, l_blue;
-
-  /* Stuff I don't really understand from Pimoroni's HSV/RGB conversions! */
-  float         i, f;
-  uint_fast8_t  p, q, t;
+  static const int32_t  l_hue_midnight = UC_HUE_MIDNIGHT * 6.0 * 16777216 + 0.5;
+  static const int32_t  l_hue_midday = UC_HUE_MIDDAY * 6.0 * 16777216 + 0.5;
+  static const int32_t  l_hue_offset = UC_HUE_OFFSET * 6.0 * 16777216 - 0.5;
+  static const int32_t  l_sat_midnight = UC_SAT_MIDNIGHT * 65536.0 + 0.5;
+  static const int32_t  l_sat_midday = UC_SAT_MIDDAY * 65536.0 + 0.5;
+  static const int32_t  l_val_midnight = UC_VAL_MIDNIGHT * 255.0 * 65536 + 0.5;
+  static const int32_t  l_val_midday = UC_VAL_MIDDAY * 255.0 * 65536 + 0.5;
+  int32_t               l_center_proximity, l_midpoint;
+  int32_t               l_hue, l_sat, l_val, l_sector, l_fraction;
+  uint_fast8_t          l_red, l_green, l_blue;
+  uint_fast8_t          p, q, t, v;
 
   /* Work out the base HSV values. */
-  l_hue = ( ( UC_HUE_MIDDAY - UC_HUE_MIDNIGHT ) * p_midday_percent ) + UC_HUE_MIDNIGHT;
-  l_sat = ( ( UC_SAT_MIDDAY - UC_SAT_MIDNIGHT ) * p_midday_percent ) + UC_SAT_MIDNIGHT;
-  l_val = ( ( UC_VAL_MIDDAY - UC_VAL_MIDNIGHT ) * p_midday_percent ) + UC_VAL_MIDNIGHT;
+  l_hue = ( (int64_t)( l_hue_midday - l_hue_midnight ) * p_midday_percent ) / UC_GRADIENT_STEPS + l_hue_midnight;
+  l_sat = ( (int64_t)( l_sat_midday - l_sat_midnight ) * p_midday_percent ) / UC_GRADIENT_STEPS + l_sat_midnight;
+  l_val = ( (int64_t)( l_val_midday - l_val_midnight ) * p_midday_percent ) / UC_GRADIENT_STEPS + l_val_midnight;
 
   /* The hue then varies based on the column. */
-  l_midpoint = pimoroni::GalacticUnicorn::WIDTH / 2;
+  l_midpoint = UC_PANEL_WIDTH / 2;
   l_center_proximity = l_midpoint - abs( p_column - l_midpoint );
-  l_hue += ( UC_HUE_OFFSET * l_center_proximity / l_midpoint );
+  l_hue += ( l_hue_offset * l_center_proximity / l_midpoint );
 
-  /* Convert all this into RGB (with ... weird code) */
-  i = floor( l_hue * 6.0f );
-  f = l_hue * 6.0f - i;
-  l_val *= 255.0f;
+  /* Split the hue into the sextant, and how far through it we are. */
+  l_sector = l_hue >> 24;
+  l_fraction = l_hue & 0xffffff;
 
-  p = l_val * ( 1.0f - l_sat );
-  q = l_val * ( 1.0f - f * l_sat );
-  t = l_val * ( 1.0f - (1.0f - f) * l_sat );
+  /* Now the usual HSV conversion, with suitable shifts. */
+  v = l_val >> 16;
+  p = ( (uint64_t)l_val * ( 65536 - l_sat ) ) >> 32;
+  q = ( (uint64_t)l_val * ( ( ( 1ULL << 40 ) - (uint64_t)l_fraction * l_sat ) >> 16 ) ) >> 40;
+  t = ( (uint64_t)l_val * ( ( ( 1ULL << 40 ) - (uint64_t)( 16777216 - l_fraction ) * l_sat ) >> 16 ) ) >> 40;
 
-  switch( int( i ) % 6 ) 
+  switch( l_sector % 6 ) 
   {
-    case 0: l_red = l_val;  l_green = t;      l_blue = p;     break;
-    case 1: l_red = q;      l_green = l_val;  l_blue = p;     break;
-    case 2: l_red = p;      l_green = l_val;  l_blue = t;     break;
-    case 3: l_red = p;      l_green = q;      l_blue = l_val; break;
-    case 4: l_red = t;      l_green = p;      l_blue = l_val; break;
-    case 5: l_red = l_val;  l_green = p;      l_blue = q;     break;    
+    case 0: l_red = v;  l_green = t;  l_blue = p;  break;
+    case 1: l_red = q;  l_green = v;  l_blue = p;  break;
+    case 2: l_red = p;  l_green = v;  l_blue = t;  break;
+    case 3: l_red = p;  l_green = q;  l_blue = v;  break;
+    case 4: l_red = t;  l_green = p;  l_blue = v;  break;
+    default:
+    case 5: l_red = v;  l_green = p;  l_blue = q;  break;    
   }
 
-  /* Ok, end of that horrid bit of copypasta. Just build the pen. */
-  return m_graphics->create_pen( l_red, l_green, l_blue );
+  /* And pack it up, ready to be turned into a pen. */
+  return ( l_red << 16 ) | ( l_green << 8 ) | l_blue;
 }
 
 
-/* Functions.*/
-
-/*
- * read - attempts to read the configuration file; if it doesn't exist, it 
- *        will be created with some reasonable defaults. Returns a time/size
- *        stamp that can be used to identify when the file is changed.
- */
-
 /*
- * init - sets up the display handling.
+ * update_gradient - makes sure the cached gradient pens reflect the provided
+ *                   midday percentage (in 1/UC_GRADIENT_STEPS steps); the pen 
+ *                   generation is only repeated when that changes.
  */
 
-void display_init( pimoroni::GalacticUnicorn *p_unicorn, pimoroni::PicoGraphics *p_graphics )
+static void display_update_gradient( uint_fast16_t p_midday_percent )
 {
-  /* Keep a reference to the graphics and the board. */
-  m_unicorn = p_unicorn;
-  m_graphics = p_graphics;
+  uint_fast8_t  l_column;
+  uint32_t      l_colour;
 
-  /* Create our black and white pens. */
-  m_black_pen = m_graphics->create_pen( 0, 0, 0 );
-  m_white_pen = m_graphics->create_pen( 255, 255, 255 );
+  /* Nothing to do if the cached pens are already for this percentage. */
+  if ( (int)p_midday_percent == m_gradient_bucket )
+  {
+    return;
+  }
 
-  /* And set the font and other basics. */
-  m_graphics->set_font( &clockfont );
-  m_base_brightness = 0.5f;
-  m_brightness_display = m_mode_timer = 0;
-  m_display_mode = UC_DISPLAY_TIME;
+  /* Rebuild the colours for each column. */
+  for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+  {
+    l_colour = display_gradient_colour( p_midday_percent, l_column );
+#ifdef UC_FRAMEBUFFER_P8
+    /* Each column has its own palette entry, so we just change that. */
+    m_graphics->update_pen( UC_GRADIENT_PEN_BASE + l_column, 
+                            l_colour >> 16, ( l_colour >> 8 ) & 0xff, l_colour & 0xff );
+    m_palette_changed = true;
+#else
+    /* Otherwise, we need a pen for this colour. */
+    m_gradient_pens[l_column] = display_intern_pen( l_colour >> 16, ( l_colour >> 8 ) & 0xff, 
+                                                    l_colour & 0xff );
+#endif
+  }
 
-  /* All done. */
+  /* And remember which percentage that was. */
+  m_gradient_bucket = p_midday_percent;
   return;
 }
 
 
 /*
- * render - draws the current display onto the provided graphics context.
+ * rect_union - grows a rectangle to also cover another; empty rectangles
+ *              don't cover anything at all.
  */
 
-void display_render( const uc_config_t *p_config )
+static void display_rect_union( uc_rect_t *p_rect, const uc_rect_t *p_other )
 {
-  datetime_t      l_time;
-  char            l_buffer[16];
-  static bool     l_blink = true;
-  uint_fast8_t    l_index, l_digit_offset;
-  uint_fast8_t    l_row, l_column, l_length;
-  float           l_midday_percent;
-
-  /* First, clear the screen. */
-  m_graphics->set_pen( m_black_pen );
-  m_graphics->clear();
+  int32_t l_right, l_bottom;
 
-  /* Exactly what we draw now depends on our display mode. */
-  switch( m_display_mode )
+  /* Adding nothing changes nothing, and adding to nothing is simple. */
+  if ( ( p_other->width <= 0 ) || ( p_other->height <= 0 ) )
   {
-    case  UC_DISPLAY_TIMEZONE:
-      /*
-       * Display the current timezone; textual if we have one, but falling
-       * back to a simple "UTC+n" if not.
-       */
-
-      /* First off, grab the timezone to work out what sort of display. */
-      if ( false )
-      {
-        /* Handle potentially long text string timezones... */
-      }
-      else
-      {
-        /* Then we just show it as an offset. */
-        snprintf( l_buffer, 15, "UTC%+d", time_get_utc_offset() / 60 );
-
-        /* Work out how big it is, to centralise. */
-        l_length = m_graphics->measure_text( l_buffer, 1 );
-
-        /* And just simply draw it. */
-        m_graphics->set_pen( m_white_pen );
-        m_graphics->text( l_buffer, 
-                          pimoroni::Point
-                          (
-                            ( pimoroni::GalacticUnicorn::WIDTH - l_length ) / 2, 2
-                          ),
-                          l_length, 1
-                        );
-
-        /* And keep ticking down the display. */
-        m_mode_timer--;
-        if ( m_mode_timer == 0 )
-        {
-          m_display_mode = UC_DISPLAY_TIME;
-        }
+    return;
+  }
+  if ( ( p_rect->width <= 0 ) || ( p_rect->height <= 0 ) )
+  {
+    *p_rect = *p_other;
+    return;
+  }
 
-      }
+  /* Otherwise, grow it to cover both. */
+  l_right = ( p_other->x + p_other->width > p_rect->x + p_rect->width ) ? 
+              p_other->x + p_other->width : p_rect->x + p_rect->width;
+  l_bottom = ( p_other->y + p_other->height > p_rect->y + p_rect->height ) ? 
+               p_other->y + p_other->height : p_rect->y + p_rect->height;
+  p_rect->x = ( p_other->x < p_rect->x ) ? p_other->x : p_rect->x;
+  p_rect->y = ( p_other->y < p_rect->y ) ? p_other->y : p_rect->y;
+  p_rect->width = l_right - p_rect->x;
+  p_rect->height = l_bottom - p_rect->y;
 
-      break;
+  /* All done. */
+  return;
+}
 
-    case UC_DISPLAY_DATE:
-      /*
-       * Display the date; I suppose in the name of being nice to insane nations,
-       * we should allow odd formats here.
-       */
 
-      /* We'll need the time, obviously. */
-      rtc_get_datetime( &l_time );
+/*
+ * damage - notes that part of the face's layer has been drawn on, so that it
+ *          gets copied out to the display when the frame is composed. We 
+ *          just keep a single rectangle that covers everything drawn.
+ */
 
-      /* Format it appropriately. */
-      if ( strcmp( p_config->date_format, "mdy" ) == 0 )
-      {
-        /* Nasty American ordering. Should be illegal. */
-        snprintf( l_buffer, 15, "%02d/%02d/%04d", l_time.month, l_time.day, l_time.year );
-      }
-      else
-      {
-        /* Default to the most sensible option... */
-        snprintf( l_buffer, 15, "%02d/%02d/%04d", l_time.day, l_time.month, l_time.year );
-      }
+static void display_damage( int32_t p_x, int32_t p_y, int32_t p_width, int32_t p_height )
+{
+  uc_rect_t l_rect = { p_x, p_y, p_width, p_height };
 
-      /* And just simply draw it. */
-      l_length = m_graphics->measure_text( l_buffer, 1 );
-      m_graphics->set_pen( m_white_pen );
-      m_graphics->text( l_buffer, 
-                        pimoroni::Point
-                        (
-                          ( pimoroni::GalacticUnicorn::WIDTH - l_length ) / 2, 2
-                        ),
-                        l_length, 1
-                      );
-
-      /* And keep ticking down the display. */
-      m_mode_timer--;
-      if ( m_mode_timer == 0 )
-      {
-        m_display_mode = UC_DISPLAY_TIME;
-      }
+  display_rect_union( &m_damage, &l_rect );
+  return;
+}
 
-      break;
 
-    case UC_DISPLAY_TIME:
-      /*
-       * Display the time, in white, with a coloured background heavily
-       * inspired by the original clock.py demo from Pimoroni.
-       */
+/*
+ * clip - works out which part of a cell drawn at the given position actually
+ *        lands on the display, in the cell's own coordinates. Returns false
+ *        if none of it does.
+ */
 
-      /* Now, we'll need to know the current time. */
-      rtc_get_datetime( &l_time );
-      snprintf( l_buffer, 15, "%02d:%02d:%02d", 
-                l_time.hour, l_time.min, l_time.sec );
+static bool display_clip( int32_t p_x, int32_t p_y, int32_t p_width, int32_t p_height,
+                          uc_rect_t *p_visible )
+{
+  /* Trim whatever hangs off each edge. */
+  p_visible->x = ( p_x < 0 ) ? -p_x : 0;
+  p_visible->y = ( p_y < 0 ) ? -p_y : 0;
+  p_visible->width = ( ( p_x + p_width > UC_PANEL_WIDTH ) ? UC_PANEL_WIDTH - p_x : p_width ) - p_visible->x;
+  p_visible->height = ( ( p_y + p_height > UC_PANEL_HEIGHT ) ? UC_PANEL_HEIGHT - p_y : p_height ) - p_visible->y;
+
+  /* And see if there's anything left. */
+  return ( p_visible->width > 0 ) && ( p_visible->height > 0 );
+}
 
-      /* Render each digit individually, to ensure they're fixed width. */
-      m_graphics->set_pen( m_white_pen );
-      m_graphics->text( l_buffer, pimoroni::Point( 10, 2 ), pimoroni::GalacticUnicorn::WIDTH, 1 );
 
-      /* Add blinking separators, to show we're alive. */
-      if ( l_blink )
-      {
-        m_graphics->set_pen( m_black_pen );
-        m_graphics->pixel( pimoroni::Point( 20, 4 ) ); 
-        m_graphics->pixel( pimoroni::Point( 20, 6 ) );
+/*
+ * fill_rect - fills a rectangle with the provided pen, keeping track of how
+ *             many pixels we've touched in this frame. This writes runs of
+ *             pixels straight into the face's layer, rather than going
+ *             through PicoGraphics a pixel at a time.
+ */
 
-        m_graphics->pixel( pimoroni::Point( 32, 4 ) );
-        m_graphics->pixel( pimoroni::Point( 32, 6 ) );
+void display_fill_rect( int p_pen, int32_t p_x, int32_t p_y, 
+                        int32_t p_width, int32_t p_height )
+{
+  uc_pixel_t *l_row;
+  int32_t     l_index;
 
-      }
-      l_blink = !l_blink;
+  /* Clip the rectangle to the display. */
+  if ( p_x < 0 )
+  {
+    p_width += p_x;
+    p_x = 0;
+  }
+  if ( p_y < 0 )
+  {
+    p_height += p_y;
+    p_y = 0;
+  }
+  if ( p_x + p_width > UC_PANEL_WIDTH )
+  {
+    p_width = UC_PANEL_WIDTH - p_x;
+  }
+  if ( p_y + p_height > UC_PANEL_HEIGHT )
+  {
+    p_height = UC_PANEL_HEIGHT - p_y;
+  }
+  if ( ( p_width <= 0 ) || ( p_height <= 0 ) )
+  {
+    return;
+  }
 
-      /*
-       * The gradient background changes based on the current time of day,
-       * with a nice fade into the centre.
-       */
-      l_midday_percent = display_calc_midday_percent( &l_time );
+  /* Work out where the first row starts. */
+  display_damage( p_x, p_y, p_width, p_height );
+  l_row = &m_base[( p_y * UC_PANEL_WIDTH ) + p_x];
 
-      for ( l_column = 0; l_column < pimoroni::GalacticUnicorn::WIDTH; l_column++ )
-      {
-        /* Set the right colour. */
-        m_graphics->set_pen( create_gradient_pen( l_midday_percent, l_column ) );
+  /* And fill each row in turn. */
+  while( p_height-- > 0 )
+  {
+    for ( l_index = 0; l_index < p_width; l_index++ )
+    {
+      l_row[l_index] = p_pen;
+    }
+    l_row += UC_PANEL_WIDTH;
+    m_frame_pixels += p_width;
+  }
 
-        /* Always draw the top and bottom bars. */
-        m_graphics->pixel( pimoroni::Point( l_column, 0 ) );
-        m_graphics->pixel( pimoroni::Point( l_column, pimoroni::GalacticUnicorn::HEIGHT - 1 ) );
+  /* All done. */
+  return;
+}
 
-        /* At the edges, full height. */
-        if ( ( l_column < 8 ) || ( l_column > 44 ) )
-        {
-          for ( l_row = 1; l_row < pimoroni::GalacticUnicorn::HEIGHT - 1; l_row++ )
-          {
-            m_graphics->pixel( pimoroni::Point( l_column, l_row ) );
-          }
-        }
 
-        /* And lastly, round the corners. */
-        if ( ( l_column == 8 ) || ( l_column == 44 ) )
-        {
-          m_graphics->pixel( pimoroni::Point( l_column, 1 ) );
-          m_graphics->pixel( pimoroni::Point( l_column, pimoroni::GalacticUnicorn::HEIGHT - 2 ) );          
-        }
-      }
+/*
+ * draw_pixel - sets a single pixel to the provided pen, again keeping track
+ *              of the pixels touched.
+ */
 
-      break;
+void display_draw_pixel( int p_pen, int32_t p_x, int32_t p_y )
+{
+  /* Anything off the display is simply dropped. */
+  if ( ( p_x < 0 ) || ( p_x >= UC_PANEL_WIDTH ) || ( p_y < 0 ) || ( p_y >= UC_PANEL_HEIGHT ) )
+  {
+    return;
   }
 
-  /* 
-   * If the brightness adjustment display is required, draw that. We do this at
-   * the end to make sure it overlays on whatever else we're showing.
-   */
-  if ( m_brightness_display > 0 )
+  /* Otherwise, straight into the framebuffer. */
+  m_base[( p_y * UC_PANEL_WIDTH ) + p_x] = p_pen;
+  m_frame_pixels++;
+  display_damage( p_x, p_y, 1, 1 );
+  return;
+}
+
+
+/*
+ * build_atlas - pre-rasterises the font into the glyph atlas. The font holds
+ *               each character as a set of column bytes, which is awkward to
+ *               draw from; the atlas holds a row-major bitmask for each glyph
+ *               instead, along with the width of its cell. The font's extra
+ *               glyphs follow straight on from the basic character set, so
+ *               they're drawn as characters 0x80 onwards.
+ */
+
+static void display_build_atlas( void )
+{
+  uint_fast8_t    l_glyph, l_row, l_column;
+  const uint8_t  *l_columns;
+
+  /* Work through every glyph; the basic character set, then the extras. */
+  for ( l_glyph = 0; l_glyph < UC_ATLAS_GLYPHS; l_glyph++ )
   {
-    /* Draw a vertical bar, height based on current brightness. */
-    m_graphics->set_pen( m_white_pen );
-    for ( l_index = 0; l_index < pimoroni::GalacticUnicorn::HEIGHT; l_index++ )
+    /* Find the column data for this glyph. */
+    l_columns = &clockfont.data[l_glyph * clockfont.max_width];
+
+    /* And turn that into rows of bits. */
+    for ( l_row = 0; l_row < UC_GLYPH_HEIGHT; l_row++ )
     {
-      if ( l_index <= ( m_base_brightness * pimoroni::GalacticUnicorn::HEIGHT ) )
+      m_glyph_rows[l_glyph][l_row] = 0;
+      for ( l_column = 0; l_column < clockfont.widths[l_glyph]; l_column++ )
       {
-        m_graphics->pixel( pimoroni::Point(
-          pimoroni::GalacticUnicorn::WIDTH - 1,
-          pimoroni::GalacticUnicorn::HEIGHT - l_index - 1
-        ) );
+        if ( l_columns[l_column] & ( 1 << l_row ) )
+        {
+          m_glyph_rows[l_glyph][l_row] |= ( 1 << l_column );
+        }
       }
     }
 
-    /* Count down the frames so we eventually stop displaying it. */
-    m_brightness_display--;
+    /* The cell includes the spacing after the character. */
+    m_glyph_widths[l_glyph] = clockfont.widths[l_glyph] + 1;
   }
 
   /* All done. */
@@ -341,109 +515,2334 @@ void display_render( const uc_config_t *p_config )
 
 
 /*
- * update_brightness - called intermittently, to modify the brightness based
- *                     on ambient light. We don't need to do this constantly,
- *                     it's primarily to auto-dim the display at night.
+ * glyph_width - returns the width of a character's cell, including spacing.
  */
 
-void display_update_brightness( void )
+uint_fast8_t display_glyph_width( char p_char )
 {
-  float   l_ambient_adjustment;
-  float   l_brightness;
+  /* The atlas holds the basic character set, and the font's extras above it. */
+  if ( ( (uint8_t)p_char < ' ' ) || ( (uint8_t)p_char >= ' ' + UC_ATLAS_GLYPHS ) )
+  {
+    return 0;
+  }
+  return m_glyph_widths[(uint8_t)p_char - ' '];
+}
+
 
-  /* Work out an adjustment factor, based on the current light levels. */
-  l_ambient_adjustment = ( m_unicorn->light() + 512.0f ) / 2048.0f;
+/*
+ * blit_glyph - draws a character cell from the atlas straight into the 
+ *              framebuffer, in the provided foreground and background pens.
+ */
 
-  /* And apply that to the base brightness. */
-  l_brightness = m_base_brightness * l_ambient_adjustment;
+static void display_blit_glyph( char p_char, int32_t p_x, int32_t p_y, 
+                                int p_fg_pen, int p_bg_pen )
+{
+  uc_pixel_t     *l_row;
+  const uint8_t  *l_bits;
+  uc_rect_t       l_visible;
+  int32_t         l_column, l_row_index;
 
-  /* Sanity check that it's not too low. */
-  if ( l_brightness < 0.1f )
+  /* Make sure it's a glyph we know about, and clip it to the display. */
+  if ( !display_clip( p_x, p_y, display_glyph_width( p_char ), UC_GLYPH_HEIGHT, &l_visible ) )
   {
-    l_brightness = 0.1f;
+    return;
   }
 
-  /* Good; now just set it. */
-  m_unicorn->set_brightness( l_brightness );
+  /* Find the glyph, and where it's going. */
+  l_bits = m_glyph_rows[(uint8_t)p_char - ' '];
+  l_row = &m_base[( ( p_y + l_visible.y ) * UC_PANEL_WIDTH ) + p_x + l_visible.x];
 
-  /* All done. */
+  /* And copy it, a row at a time. */
+  for ( l_row_index = l_visible.y; l_row_index < l_visible.y + l_visible.height; l_row_index++ )
+  {
+    for ( l_column = l_visible.x; l_column < l_visible.x + l_visible.width; l_column++ )
+    {
+      l_row[l_column - l_visible.x] = ( l_bits[l_row_index] & ( 1 << l_column ) ) ? p_fg_pen : p_bg_pen;
+    }
+    l_row += UC_PANEL_WIDTH;
+  }
+
+  /* Keep count of the pixels, and where they were. */
+  m_frame_pixels += l_visible.width * l_visible.height;
+  display_damage( p_x + l_visible.x, p_y + l_visible.y, l_visible.width, l_visible.height );
   return;
 }
 
 
 /*
- * dimmer - reduces the target brightness, which is adjusted by ambient light.
+ * blit_scaled_glyph - draws a character cell stretched to a larger size; the
+ *                     width is a simple multiple, while the rows of the glyph
+ *                     are spread over the requested height.
  */
 
-void display_dimmer( void )
+void display_blit_scaled_glyph( char p_char, int32_t p_x, int32_t p_y, uint_fast8_t p_scale,
+                                uint_fast8_t p_height, int p_fg_pen, int p_bg_pen )
 {
-  /* Simply reduce the base brightness, unless it's already at the lowest. */
-  if ( m_base_brightness > 0.1f )
+  uc_pixel_t     *l_row;
+  const uint8_t  *l_bits;
+  uc_rect_t       l_visible;
+  int32_t         l_column, l_row_index;
+  uint_fast8_t    l_bits_row;
+
+  /* Make sure it's a glyph we know about, and clip it to the display. */
+  if ( !display_clip( p_x, p_y, display_glyph_width( p_char ) * p_scale, p_height, &l_visible ) )
   {
-    m_base_brightness -= 0.1f;
+    return;
   }
 
-  /* We want to render some visual feedback to the change. */
-  m_brightness_display = 5;
+  /* Find the glyph, and where it's going. */
+  l_bits = m_glyph_rows[(uint8_t)p_char - ' '];
+  l_row = &m_base[( ( p_y + l_visible.y ) * UC_PANEL_WIDTH ) + p_x + l_visible.x];
 
-  /* And update the brightness immediately. */
-  display_update_brightness();
+  /* Each row of the output picks the glyph row it falls in. */
+  for ( l_row_index = l_visible.y; l_row_index < l_visible.y + l_visible.height; l_row_index++ )
+  {
+    l_bits_row = ( l_row_index * UC_GLYPH_INK_HEIGHT ) / p_height;
+    for ( l_column = l_visible.x; l_column < l_visible.x + l_visible.width; l_column++ )
+    {
+      l_row[l_column - l_visible.x] = ( l_bits[l_bits_row] & ( 1 << ( l_column / p_scale ) ) ) ? p_fg_pen : p_bg_pen;
+    }
+    l_row += UC_PANEL_WIDTH;
+  }
 
-  /* All done. */
+  /* Keep count of the pixels, and where they were. */
+  m_frame_pixels += l_visible.width * l_visible.height;
+  display_damage( p_x + l_visible.x, p_y + l_visible.y, l_visible.width, l_visible.height );
   return;
 }
 
 
 /*
- * brighter - increases the target brightness, which is adjusted by ambient light.
+ * layout_text - works out where to draw a line of text so that it's centred.
+ *               Layouts are cached by the text itself, so that text which is
+ *               shown over and over is only ever measured once; if the caller
+ *               already knows the width, that saves measuring it at all.
  */
 
-void display_brighter( void )
+static const uc_layout_t *display_layout_text( const char *p_text, uint_fast16_t p_width )
 {
-  /* Simply increase the base brightness, unless it's already at the highest. */
-  if ( m_base_brightness < 1.0f )
+  uc_layout_t  *l_layout;
+  const char   *l_char;
+  uint32_t      l_hash;
+  uint_fast8_t  l_index;
+
+  /* Hash the text, to make the search quick. */
+  l_hash = 2166136261UL;
+  for ( l_char = p_text; *l_char != '\0'; l_char++ )
   {
-    m_base_brightness += 0.1f;
+    l_hash = ( l_hash ^ (uint8_t)*l_char ) * 16777619UL;
   }
 
-  /* We want to render some visual feedback to the change. */
-  m_brightness_display = 5;
+  /* See if we've laid this out before. */
+  for ( l_index = 0; l_index < UC_LAYOUT_CACHE_SIZE; l_index++ )
+  {
+    if ( ( m_layouts[l_index].hash == l_hash ) && 
+         ( strcmp( m_layouts[l_index].text, p_text ) == 0 ) )
+    {
+      return &m_layouts[l_index];
+    }
+  }
 
-  /* And update the brightness immediately. */
-  display_update_brightness();
+  /* No, so measure it (if need be) and take over the oldest entry. */
+  if ( p_width == 0 )
+  {
+    for ( l_char = p_text; *l_char != '\0'; l_char++ )
+    {
+      p_width += display_glyph_width( *l_char );
+    }
+  }
+  l_layout = &m_layouts[m_layout_next];
+  m_layout_next = ( m_layout_next + 1 ) % UC_LAYOUT_CACHE_SIZE;
+  strncpy( l_layout->text, p_text, UC_TEXT_MAXLEN );
+  l_layout->text[UC_TEXT_MAXLEN] = '\0';
+  l_layout->hash = l_hash;
+  l_layout->width = p_width;
+  l_layout->x = ( UC_PANEL_WIDTH - (int32_t)p_width ) / 2;
+  if ( l_layout->x < 0 )
+  {
+    l_layout->x = 0;
+  }
 
   /* All done. */
-  return;  
+  return l_layout;
 }
 
 
 /*
- * timezone - show the currently set timezone, for a period of time.
+ * time_cells - checks if a string lines up with the panel's time cells, in
+ *              which case it can be drawn into them; anything else is just
+ *              drawn along a line, starting from the first cell.
  */
 
-void display_timezone( void )
+static bool display_time_cells( const char *p_text )
 {
-  /* Just switch display mode, and set the display timer. */
-  m_display_mode = UC_DISPLAY_TIMEZONE;
-  m_mode_timer = 5;
+  uint_fast8_t  l_index;
 
-  /* All done. */
-  return;
+  for ( l_index = 0; l_index < UC_TIME_CELLS; l_index++ )
+  {
+    if ( ( p_text[l_index] == '\0' ) || 
+         ( display_glyph_width( p_text[l_index] ) != uc_panel_cell_width( l_index ) ) )
+    {
+      return false;
+    }
+  }
+  return ( p_text[UC_TIME_CELLS] == '\0' );
 }
 
+
 /*
- * date - show the current date, for a period of time.
+ * fit_text - fits a string which doesn't line up with the time cells into the
+ *            window; anything that won't fit is cut off the end, and what's
+ *            left is centred. Returns where the string should start.
  */
 
-void display_date( void )
+static int32_t display_fit_text( char *p_text )
+{
+  int32_t       l_space, l_width = 0;
+  uint_fast8_t  l_index;
+
+  /* Measure it up, stopping at the first character which won't fit. */
+  l_space = uc_panel.window_right - uc_panel.window_left + 1;
+  for ( l_index = 0; p_text[l_index] != '\0'; l_index++ )
+  {
+    if ( l_width + display_glyph_width( p_text[l_index] ) > l_space )
+    {
+      p_text[l_index] = '\0';
+      break;
+    }
+    l_width += display_glyph_width( p_text[l_index] );
+  }
+
+  /* And centre whatever is left. */
+  return uc_panel.window_left + ( l_space - l_width ) / 2;
+}
+
+
+/*
+ * draw_cells - draws a string one character cell at a time, only drawing the
+ *              cells that differ from what we last drew. Returns a bitmap of
+ *              the cells which were redrawn. If asked to, the cells are put
+ *              where the panel layout says, rather than along a line.
+ */
+
+static uint32_t display_draw_cells( const char *p_text, int32_t p_x, int32_t p_y, bool p_time_cells )
 {
-  /* Just switch display mode, and set the display timer. */
-  m_display_mode = UC_DISPLAY_DATE;
-  m_mode_timer = 10;
+  uint_fast8_t  l_index;
+  uint32_t      l_redrawn = 0;
+
+  /* Work through the string. */
+  for ( l_index = 0; p_text[l_index] != '\0'; l_index++ )
+  {
+    if ( p_time_cells )
+    {
+      p_x = uc_panel.time_x[l_index];
+      p_y = uc_panel.time_y[l_index];
+    }
+
+    /* Only draw the cell if it's changed. */
+    if ( p_text[l_index] != m_drawn_text[l_index] )
+    {
+      /* Blit the character from the atlas; hidden cells are simply skipped. */
+      display_blit_glyph( p_text[l_index], p_x, p_y, m_white_pen, m_black_pen );
+
+      /* And remember that we did. */
+      if ( m_drawn_text[l_index] == '\0' )
+      {
+        m_drawn_text[l_index+1] = '\0';
+      }
+      m_drawn_text[l_index] = p_text[l_index];
+      l_redrawn |= ( 1UL << l_index );
+    }
+
+    /* Move on to the next cell. */
+    p_x += display_glyph_width( p_text[l_index] );
+  }
 
   /* All done. */
-  return;
+  return l_redrawn;
+}
+
+
+/*
+ * blit_roll - draws a character cell part way through rolling from one glyph
+ *             to another; the old glyph moves up out of the cell by the given
+ *             number of rows, with the new one following it in from below.
+ */
+
+static void display_blit_roll( char p_from, char p_to, uint_fast8_t p_offset,
+                               int32_t p_x, int32_t p_y, int p_fg_pen, int p_bg_pen )
+{
+  uc_pixel_t     *l_row;
+  uint8_t         l_bits;
+  uc_rect_t       l_visible;
+  int32_t         l_column, l_row_index;
+  uint_fast8_t    l_source;
+
+  /* Both glyphs need to be in the atlas, and it's clipped to the display. */
+  if ( ( display_glyph_width( p_from ) == 0 ) ||
+       !display_clip( p_x, p_y, display_glyph_width( p_to ), UC_GLYPH_HEIGHT, &l_visible ) )
+  {
+    return;
+  }
+
+  /* Find where it's going. */
+  l_row = &m_base[( ( p_y + l_visible.y ) * UC_PANEL_WIDTH ) + p_x + l_visible.x];
+
+  /* And copy the rows, picking from the right glyph. */
+  for ( l_row_index = l_visible.y; l_row_index < l_visible.y + l_visible.height; l_row_index++ )
+  {
+    l_source = l_row_index + p_offset;
+    if ( l_source < UC_GLYPH_HEIGHT )
+    {
+      l_bits = m_glyph_rows[(uint8_t)p_from - ' '][l_source];
+    }
+    else
+    {
+      l_bits = m_glyph_rows[(uint8_t)p_to - ' '][l_source - UC_GLYPH_HEIGHT];
+    }
+
+    for ( l_column = l_visible.x; l_column < l_visible.x + l_visible.width; l_column++ )
+    {
+      l_row[l_column - l_visible.x] = ( l_bits & ( 1 << l_column ) ) ? p_fg_pen : p_bg_pen;
+    }
+    l_row += UC_PANEL_WIDTH;
+  }
+
+  /* Keep count of the pixels, and where they were. */
+  m_frame_pixels += l_visible.width * l_visible.height;
+  display_damage( p_x + l_visible.x, p_y + l_visible.y, l_visible.width, l_visible.height );
+  return;
+}
+
+
+/*
+ * roll_cells - looks after the rolling animation of digits. Any digits that
+ *              have changed start rolling; cells part way through a roll are
+ *              drawn here and marked as drawn so that draw_cells leaves them
+ *              alone, and once the roll is over they're handed back to it to
+ *              be drawn normally. Each cell keeps its own start time, so a
+ *              new change never restarts a roll that's already under way.
+ */
+
+static void display_roll_cells( const char *p_text, int32_t p_x, int32_t p_y,
+                                bool p_time_cells, bool p_animate )
+{
+  uint_fast8_t  l_index, l_offset;
+  uint64_t      l_now;
+
+  /* Any changed digits start a new roll, if we're animating. */
+  l_now = time_us_64();
+  for ( l_index = 0; p_animate && ( p_text[l_index] != '\0' ) && 
+                     ( m_drawn_text[l_index] != '\0' ); l_index++ )
+  {
+    if ( ( p_text[l_index] != m_drawn_text[l_index] ) && ( p_text[l_index] != ':' ) &&
+         ( display_glyph_width( m_drawn_text[l_index] ) > 0 ) )
+    {
+      m_roll_from[l_index] = m_drawn_text[l_index];
+      m_roll_cells |= ( 1UL << l_index );
+      m_roll_start_us[l_index] = l_now;
+    }
+  }
+
+  /* If nothing's rolling, there's nothing else to do. */
+  if ( m_roll_cells == 0 )
+  {
+    return;
+  }
+
+  /* And draw each rolling cell. */
+  for ( l_index = 0; p_text[l_index] != '\0'; l_index++ )
+  {
+    if ( p_time_cells )
+    {
+      p_x = uc_panel.time_x[l_index];
+      p_y = uc_panel.time_y[l_index];
+    }
+    if ( m_roll_cells & ( 1UL << l_index ) )
+    {
+      /* Work out how far through its roll it is; when not animating, it's over. */
+      l_offset = UC_GLYPH_HEIGHT;
+      if ( p_animate && ( l_now - m_roll_start_us[l_index] < UC_ROLL_MS * 1000 ) )
+      {
+        l_offset = ( ( l_now - m_roll_start_us[l_index] ) * UC_GLYPH_HEIGHT ) / ( UC_ROLL_MS * 1000 );
+      }
+
+      if ( l_offset >= UC_GLYPH_HEIGHT )
+      {
+        /* Finished; make sure draw_cells will draw the final glyph. */
+        m_drawn_text[l_index] = '\x01';
+        m_roll_cells &= ~( 1UL << l_index );
+      }
+      else
+      {
+        display_blit_roll( m_roll_from[l_index], p_text[l_index], l_offset, 
+                           p_x, p_y, m_white_pen, m_black_pen );
+        m_drawn_text[l_index] = p_text[l_index];
+      }
+    }
+    p_x += display_glyph_width( p_text[l_index] );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * build_marquee - pre-renders a string into the off-screen marquee strip, as
+ *                 a column of bits for each pixel across.
+ */
+
+static void display_build_marquee( const char *p_text )
+{
+  uint_fast8_t    l_index, l_column, l_width;
+  const uint8_t  *l_columns;
+
+  /* Work through the string, a character at a time. */
+  m_marquee_length = 0;
+  for ( l_index = 0; p_text[l_index] != '\0'; l_index++ )
+  {
+    /* Skip anything we can't draw, or won't fit. */
+    l_width = display_glyph_width( p_text[l_index] );
+    if ( ( l_width == 0 ) || ( m_marquee_length + l_width > UC_MARQUEE_MAXCOLS ) )
+    {
+      continue;
+    }
+
+    /* Copy the glyph's columns into the strip, followed by the spacing. */
+    l_columns = &clockfont.data[( (uint8_t)p_text[l_index] - ' ' ) * clockfont.max_width];
+    for ( l_column = 0; l_column < l_width - 1; l_column++ )
+    {
+      m_marquee_columns[m_marquee_length++] = l_columns[l_column];
+    }
+    m_marquee_columns[m_marquee_length++] = 0;
+  }
+
+  /* Remember what we rendered, so we don't need to do it again. */
+  strncpy( m_marquee_text, p_text, UC_MARQUEE_MAXLEN );
+  m_marquee_text[UC_MARQUEE_MAXLEN] = '\0';
+  return;
+}
+
+
+/*
+ * marquee_column - fetches a column from the marquee strip; anything off
+ *                  either end of it is blank.
+ */
+
+static uint8_t display_marquee_column( int32_t p_column )
+{
+  if ( ( p_column < 0 ) || ( p_column >= (int32_t)m_marquee_length ) )
+  {
+    return 0;
+  }
+  return m_marquee_columns[p_column];
+}
+
+
+/*
+ * draw_marquee - draws the current window onto the marquee strip. The scroll
+ *                position is worked out from how long we've been scrolling,
+ *                in fractions of a pixel; pixels are shaded between adjacent
+ *                columns of the strip to smooth the movement. Returns false
+ *                once the text has scrolled all the way through.
+ */
+
+static bool display_draw_marquee( int32_t p_y )
+{
+  uc_pixel_t     *l_row;
+  int32_t         l_position, l_whole, l_column;
+  uint_fast8_t    l_fraction, l_row_index, l_level;
+  uint8_t         l_left, l_right;
+
+  /* Work out where we are, in 1/256ths of a pixel; we start off the right. */
+  l_position = ( ( time_us_64() - m_marquee_start_us ) * UC_MARQUEE_SPEED * 256 ) / 1000000;
+  l_position -= UC_PANEL_WIDTH * 256;
+  if ( l_position > (int32_t)m_marquee_length * 256 )
+  {
+    return false;
+  }
+
+  /* Split that into whole pixels, and the sub-pixel step. */
+  l_whole = l_position >> 8;
+  l_fraction = ( l_position & 0xff ) / ( 256 / UC_MARQUEE_SUBSTEPS );
+
+  /* Now draw the window, a column at a time. */
+  for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+  {
+    l_left = display_marquee_column( l_whole + l_column );
+    l_right = display_marquee_column( l_whole + l_column + 1 );
+    l_row = &m_base[( p_y * UC_PANEL_WIDTH ) + l_column];
+
+    for ( l_row_index = 0; l_row_index < UC_GLYPH_HEIGHT; l_row_index++ )
+    {
+      /* Shade the pixel by how much of each column it covers. */
+      l_level = 0;
+      if ( l_left & ( 1 << l_row_index ) )
+      {
+        l_level += UC_MARQUEE_SUBSTEPS - l_fraction;
+      }
+      if ( l_right & ( 1 << l_row_index ) )
+      {
+        l_level += l_fraction;
+      }
+      *l_row = m_marquee_pens[l_level];
+      l_row += UC_PANEL_WIDTH;
+    }
+  }
+
+  /* Keep count of the pixels, and where they were. */
+  m_frame_pixels += UC_PANEL_WIDTH * UC_GLYPH_HEIGHT;
+  display_damage( 0, p_y, UC_PANEL_WIDTH, UC_GLYPH_HEIGHT );
+  return true;
+}
+
+
+/*
+ * draw_background_column - draws a single column of the time display's
+ *                          gradient background.
+ */
+
+static void display_draw_background_column( uint_fast8_t p_column, int p_pen )
+{
+  /* At the edges, full height. */
+  if ( ( p_column < uc_panel.window_left ) || ( p_column > uc_panel.window_right ) )
+  {
+    display_fill_rect( p_pen, p_column, 0, 1, UC_PANEL_HEIGHT );
+    return;
+  }
+
+  /* Otherwise, always draw the top and bottom bars. */
+  display_fill_rect( p_pen, p_column, 0, 1, uc_panel.window_top );
+  display_fill_rect( p_pen, p_column, uc_panel.window_bottom + 1, 
+                     1, UC_PANEL_HEIGHT - 1 - uc_panel.window_bottom );
+
+  /* And lastly, round the corners. */
+  if ( ( p_column == uc_panel.window_left ) || ( p_column == uc_panel.window_right ) )
+  {
+    display_draw_pixel( p_pen, p_column, uc_panel.window_top );
+    display_draw_pixel( p_pen, p_column, uc_panel.window_bottom );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blend - mixes an overlay pen over the one underneath it, by the overlay's
+ *         alpha. With a palette, the mixed colour needs a pen of its own;
+ *         intern_pen never evicts those, and if the palette has run out of
+ *         entries, the overlay is simply drawn unblended.
+ */
+
+static uc_pixel_t display_blend( uc_pixel_t p_under, uc_pixel_t p_over, uint8_t p_alpha )
+{
+  int32_t   l_red, l_green, l_blue;
+
+  /* Fully opaque or transparent overlays are easy. */
+  if ( p_alpha == 255 )
+  {
+    return p_over;
+  }
+  if ( p_alpha == 0 )
+  {
+    return p_under;
+  }
+
+#ifdef UC_FRAMEBUFFER_P8
+  /* Pens are palette entries, so blend the colours they refer to. */
+  const pimoroni::RGB *l_palette = ( (pimoroni::PicoGraphics_PenP8 *)m_graphics )->palette;
+  l_red = l_palette[p_under].r + ( ( l_palette[p_over].r - l_palette[p_under].r ) * p_alpha ) / 255;
+  l_green = l_palette[p_under].g + ( ( l_palette[p_over].g - l_palette[p_under].g ) * p_alpha ) / 255;
+  l_blue = l_palette[p_under].b + ( ( l_palette[p_over].b - l_palette[p_under].b ) * p_alpha ) / 255;
+  l_red = display_intern_pen( l_red, l_green, l_blue );
+  return ( l_red < 0 ) ? p_over : l_red;
+#else
+  /* Pens are byte-swapped RGB565, so unpack them and blend each channel. */
+  uint16_t l_under = __builtin_bswap16( p_under );
+  uint16_t l_over = __builtin_bswap16( p_over );
+  l_red = ( l_under >> 11 ) + ( ( (int32_t)( l_over >> 11 ) - ( l_under >> 11 ) ) * p_alpha ) / 255;
+  l_green = ( ( l_under >> 5 ) & 0x3f ) + 
+            ( ( (int32_t)( ( l_over >> 5 ) & 0x3f ) - ( ( l_under >> 5 ) & 0x3f ) ) * p_alpha ) / 255;
+  l_blue = ( l_under & 0x1f ) + ( ( (int32_t)( l_over & 0x1f ) - ( l_under & 0x1f ) ) * p_alpha ) / 255;
+  return __builtin_bswap16( ( l_red << 11 ) | ( l_green << 5 ) | l_blue );
+#endif
+}
+
+
+/*
+ * layer_show - places an overlay layer over the face, at the given alpha; an
+ *              empty rectangle hides it. Showing, moving or hiding a layer
+ *              only means recomposing where it was, and where it is now.
+ */
+
+static void display_layer_show( uc_layer_id_t p_layer, int32_t p_x, int32_t p_y,
+                                int32_t p_width, int32_t p_height, uint8_t p_alpha )
+{
+  uc_layer_t *l_layer = &m_layers[p_layer];
+
+  /* Hidden layers all look the same. */
+  if ( ( p_width <= 0 ) || ( p_height <= 0 ) )
+  {
+    p_x = p_y = p_width = p_height = 0;
+  }
+
+  /* And nothing needs doing unless something's changed. */
+  if ( ( l_layer->bounds.x != p_x ) || ( l_layer->bounds.y != p_y ) || 
+       ( l_layer->bounds.width != p_width ) || ( l_layer->bounds.height != p_height ) ||
+       ( l_layer->alpha != p_alpha ) )
+  {
+    l_layer->bounds.x = p_x;
+    l_layer->bounds.y = p_y;
+    l_layer->bounds.width = p_width;
+    l_layer->bounds.height = p_height;
+    l_layer->alpha = p_alpha;
+    l_layer->changed = true;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * layer_fill - fills part of an overlay layer with the provided pen; only 
+ *              the part within the layer's bounds will ever be seen.
+ */
+
+static void display_layer_fill( uc_layer_id_t p_layer, int p_pen, int32_t p_x, int32_t p_y,
+                                int32_t p_width, int32_t p_height )
+{
+  uc_layer_t *l_layer = &m_layers[p_layer];
+  int32_t     l_x, l_y;
+
+  /* Clip the rectangle to the display, and fill it. */
+  for ( l_y = ( p_y < 0 ) ? 0 : p_y; ( l_y < p_y + p_height ) && ( l_y < UC_PANEL_HEIGHT ); l_y++ )
+  {
+    for ( l_x = ( p_x < 0 ) ? 0 : p_x; ( l_x < p_x + p_width ) && ( l_x < UC_PANEL_WIDTH ); l_x++ )
+    {
+      l_layer->pixels[( l_y * UC_PANEL_WIDTH ) + l_x] = p_pen;
+    }
+  }
+  l_layer->changed = true;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * compose_rect - copies part of the face's layer out to the display, and then
+ *                blends any overlays over it; overlays are only ever blended
+ *                within their own bounds.
+ */
+
+static void display_compose_rect( const uc_rect_t *p_rect )
+{
+  uc_pixel_t         *l_output = (uc_pixel_t *)m_graphics->frame_buffer;
+  const uc_layer_t   *l_layer;
+  uint_fast8_t        l_index;
+  int32_t             l_x, l_y, l_left, l_right, l_top, l_bottom;
+
+  /* Remember that this part of the display will need pushing out. */
+  display_rect_union( &m_output_damage, p_rect );
+
+  /* The face goes down first, a row at a time. */
+  for ( l_y = p_rect->y; l_y < p_rect->y + p_rect->height; l_y++ )
+  {
+    memcpy( &l_output[( l_y * UC_PANEL_WIDTH ) + p_rect->x], &m_base[( l_y * UC_PANEL_WIDTH ) + p_rect->x],
+            p_rect->width * sizeof( uc_pixel_t ) );
+  }
+
+  /* Then each visible overlay, where it overlaps. */
+  for ( l_index = 0; l_index < UC_LAYERS; l_index++ )
+  {
+    l_layer = &m_layers[l_index];
+    if ( ( l_layer->bounds.width == 0 ) || ( l_layer->alpha == 0 ) )
+    {
+      continue;
+    }
+    l_left = ( l_layer->bounds.x > p_rect->x ) ? l_layer->bounds.x : p_rect->x;
+    l_top = ( l_layer->bounds.y > p_rect->y ) ? l_layer->bounds.y : p_rect->y;
+    l_right = ( l_layer->bounds.x + l_layer->bounds.width < p_rect->x + p_rect->width ) ?
+                l_layer->bounds.x + l_layer->bounds.width : p_rect->x + p_rect->width;
+    l_bottom = ( l_layer->bounds.y + l_layer->bounds.height < p_rect->y + p_rect->height ) ?
+                 l_layer->bounds.y + l_layer->bounds.height : p_rect->y + p_rect->height;
+    for ( l_y = l_top; l_y < l_bottom; l_y++ )
+    {
+      for ( l_x = l_left; l_x < l_right; l_x++ )
+      {
+        l_output[( l_y * UC_PANEL_WIDTH ) + l_x] = 
+          display_blend( l_output[( l_y * UC_PANEL_WIDTH ) + l_x], 
+                         l_layer->pixels[( l_y * UC_PANEL_WIDTH ) + l_x], l_layer->alpha );
+      }
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * compose - builds the frame on the display from the face and its overlays,
+ *           only touching what has changed. Returns the number of pixels 
+ *           that had to be refreshed because an overlay changed.
+ */
+
+static uint32_t display_compose( void )
+{
+  uc_layer_t   *l_layer;
+  uc_rect_t     l_rect;
+  uint_fast8_t  l_index;
+  uint32_t      l_pixels = 0;
+
+  /* Whatever the face drew goes out, with any overlays on top. */
+  if ( ( m_damage.width > 0 ) && ( m_damage.height > 0 ) )
+  {
+    display_compose_rect( &m_damage );
+  }
+  m_damage.width = m_damage.height = 0;
+
+  /* And overlays that have changed are redone where they were, and are now. */
+  for ( l_index = 0; l_index < UC_LAYERS; l_index++ )
+  {
+    l_layer = &m_layers[l_index];
+
+    /* Blended pens follow the palette, so need refreshing when that changes. */
+    if ( m_palette_changed && ( l_layer->alpha < 255 ) && ( l_layer->bounds.width > 0 ) )
+    {
+      l_layer->changed = true;
+    }
+
+    if ( l_layer->changed )
+    {
+      l_rect = l_layer->drawn;
+      display_rect_union( &l_rect, &l_layer->bounds );
+      if ( ( l_rect.width > 0 ) && ( l_rect.height > 0 ) )
+      {
+        display_compose_rect( &l_rect );
+        l_pixels += l_rect.width * l_rect.height;
+      }
+      l_layer->drawn = l_layer->bounds;
+      l_layer->changed = false;
+    }
+  }
+
+  /* All done. */
+  return l_pixels;
+}
+
+
+/*
+ * build_brightness_lut - works out the display brightness for each perceived
+ *                        brightness level, using the CIE 1931 lightness curve.
+ *                        Values are in 1/256ths of the Unicorn's own brightness
+ *                        steps, so that we can dither between them.
+ */
+
+static void display_build_brightness_lut( void )
+{
+  uint_fast16_t   l_level;
+  float           l_lightness, l_luminance;
+
+  /* Work through each level in turn; this is only done the once. */
+  for ( l_level = 0; l_level < UC_BRIGHTNESS_LEVELS; l_level++ )
+  {
+    l_lightness = ( l_level * 100.0f ) / ( UC_BRIGHTNESS_LEVELS - 1 );
+    if ( l_lightness <= 8.0f )
+    {
+      l_luminance = l_lightness / 903.3f;
+    }
+    else
+    {
+      l_luminance = ( l_lightness + 16.0f ) / 116.0f;
+      l_luminance = l_luminance * l_luminance * l_luminance;
+    }
+    m_brightness_lut[l_level] = l_luminance * 65536.0f;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * apply_brightness - sets the Unicorn's brightness to the nearest step to our
+ *                    target. At low brightness, where each step is a visible
+ *                    jump, we dither between the steps either side from frame
+ *                    to frame instead, for as long as the target falls between
+ *                    them. Returns true if the brightness changed.
+ */
+
+static bool display_apply_brightness( void )
+{
+  uint_fast16_t   l_step;
+  uint_fast8_t    l_fraction;
+
+  /* Split the target into a whole step, and the fraction beyond it. */
+  l_step = m_brightness_target >> 8;
+  l_fraction = ( m_brightness_target >> ( 8 - UC_DITHER_BITS ) ) & ( ( 1 << UC_DITHER_BITS ) - 1 );
+
+  /* Only dither when it's dim enough to matter. */
+  m_dithering = ( l_fraction != 0 ) && ( l_step < UC_DITHER_LIMIT );
+  if ( m_dithering )
+  {
+    /* Carry the fraction forward, taking the next step up when it overflows. */
+    m_dither_error += l_fraction;
+    if ( m_dither_error >= ( 1 << UC_DITHER_BITS ) )
+    {
+      m_dither_error -= ( 1 << UC_DITHER_BITS );
+      l_step++;
+    }
+  }
+  else
+  {
+    /* Otherwise, just round to the nearest step. */
+    l_step = ( m_brightness_target + 128 ) >> 8;
+  }
+
+  /* Only bother the Unicorn if something has changed. */
+  if ( l_step == m_brightness_step )
+  {
+    return false;
+  }
+  m_brightness_step = l_step;
+  m_unicorn->set_brightness( ( l_step + 0.5f ) / 256.0f );
+
+  /*
+   * The Unicorn applies brightness as pixels are set, so they all need setting
+   * again; black stays black at any brightness though, so only the lit ones.
+   */
+  m_push_lit = true;
+  return true;
+}
+
+
+/*
+ * ramp_brightness - moves the current brightness level a step closer to its
+ *                   target, so that changes fade in over a few frames rather
+ *                   than jumping. Levels are perceived brightness, with 8 bits
+ *                   of fraction to interpolate the lookup table.
+ */
+
+static void display_ramp_brightness( void )
+{
+  int32_t       l_delta;
+  uint_fast16_t l_index;
+  uint32_t      l_fraction;
+
+  /* Close a fraction of the gap, snapping to the target once it's close. */
+  l_delta = m_brightness_level_target - m_brightness_level;
+  if ( abs( l_delta ) < ( 1 << UC_RAMP_SHIFT ) )
+  {
+    m_brightness_level = m_brightness_level_target;
+  }
+  else
+  {
+    m_brightness_level += l_delta / ( 1 << UC_RAMP_SHIFT );
+  }
+
+  /* Interpolate the lookup table to find the brightness for this level. */
+  l_index = m_brightness_level >> 8;
+  l_fraction = m_brightness_level & 0xff;
+  m_brightness_target = m_brightness_lut[l_index];
+  if ( l_index < UC_BRIGHTNESS_LEVELS - 1 )
+  {
+    m_brightness_target += ( ( m_brightness_lut[l_index+1] - m_brightness_lut[l_index] ) * l_fraction ) >> 8;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * timer_arm - starts (or restarts) one of the transient display timers, to 
+ *             expire the given number of milliseconds from now. The timers 
+ *             are kept in a short queue, soonest first, so that the next 
+ *             deadline is always at the front.
+ */
+
+static void display_timer_arm( uc_timer_id_t p_id, uint32_t p_ms )
+{
+  uc_timer_t    l_timer;
+  uint_fast8_t  l_index;
+
+  /* If this timer is already queued, take it out first. */
+  for ( l_index = 0; l_index < m_timer_count; l_index++ )
+  {
+    if ( m_timers[l_index].id == p_id )
+    {
+      m_timer_count--;
+      memmove( &m_timers[l_index], &m_timers[l_index+1], 
+               ( m_timer_count - l_index ) * sizeof( uc_timer_t ) );
+      break;
+    }
+  }
+
+  /* Then slide it in ahead of anything due later. */
+  l_timer.deadline = make_timeout_time_ms( p_ms );
+  l_timer.id = p_id;
+  for ( l_index = m_timer_count; l_index > 0; l_index-- )
+  {
+    if ( absolute_time_diff_us( m_timers[l_index-1].deadline, l_timer.deadline ) >= 0 )
+    {
+      break;
+    }
+    m_timers[l_index] = m_timers[l_index-1];
+  }
+  m_timers[l_index] = l_timer;
+  m_timer_count++;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * timer_expire - pops any timers that have reached their deadline off the
+ *                front of the queue, and ends whatever they were timing.
+ */
+
+static void display_timer_expire( void )
+{
+  /* Only the front of the queue can be due. */
+  while ( ( m_timer_count > 0 ) && time_reached( m_timers[0].deadline ) )
+  {
+    switch( m_timers[0].id )
+    {
+      case UC_TIMER_FACE:
+        m_face_expired = true;
+        break;
+      case UC_TIMER_BRIGHTNESS:
+        m_brightness_display = false;
+        break;
+      default:
+        break;
+    }
+
+    /* And drop it from the queue. */
+    m_timer_count--;
+    memmove( &m_timers[0], &m_timers[1], m_timer_count * sizeof( uc_timer_t ) );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * face_time_render - the standard clock face; the time, in white, with a
+ *                    coloured background heavily inspired by the original 
+ *                    clock.py demo from Pimoroni.
+ */
+
+static void display_face_time_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  char            l_buffer[16];
+  bool            l_blink;
+  uint_fast8_t    l_index, l_column;
+  uint_fast16_t   l_midday_percent;
+  uint32_t        l_redrawn;
+  int32_t         l_cell_x, l_cell_y, l_origin;
+  bool            l_time_cells;
+
+  /*
+   * Format the current time, and see if it fits the panel's layout; if not,
+   * it's centred along the first row of cells instead.
+   */
+  format_render( &p_config->time_program, p_time, l_buffer, 15, nullptr );
+  l_time_cells = display_time_cells( l_buffer );
+  l_origin = l_time_cells ? uc_panel.time_x[0] : display_fit_text( l_buffer );
+
+  /* If that's moved, what we drew before is in the wrong place; clear it. */
+  if ( l_origin != m_drawn_origin )
+  {
+    display_fill_rect( m_black_pen, uc_panel.window_left, uc_panel.window_top + 1,
+                       uc_panel.window_right - uc_panel.window_left + 1,
+                       uc_panel.window_bottom - uc_panel.window_top - 1 );
+    m_drawn_text[0] = '\0';
+    m_roll_cells = 0;
+    m_drawn_origin = l_origin;
+  }
+
+  /* The separators blink in step with the seconds. */
+  l_blink = ( ( p_time->sec & 1 ) == 0 );
+
+  /* If the blink has changed, the separators will need redrawing. */
+  if ( l_blink != m_drawn_blink )
+  {
+    for ( l_index = 0; m_drawn_text[l_index] != '\0'; l_index++ )
+    {
+      if ( m_drawn_text[l_index] == ':' )
+      {
+        m_drawn_text[l_index] = ' ';
+      }
+    }
+    m_drawn_blink = l_blink;
+  }
+
+  /* Roll any changing digits into place, if we've been asked to. */
+  if ( m_animation_suspended && time_reached( m_animation_resume ) )
+  {
+    m_animation_suspended = false;
+  }
+  display_roll_cells( l_buffer, l_origin, uc_panel.time_y[0], l_time_cells,
+                      p_config->animate && !m_animation_suspended );
+  m_frame_animated = ( m_roll_cells != 0 );
+
+  /* Blit each digit individually, to ensure they're fixed width. */
+  l_redrawn = display_draw_cells( l_buffer, l_origin, uc_panel.time_y[0], l_time_cells );
+
+  /* Add blinking separators, to any separators we just drew. */
+  l_cell_x = l_origin;
+  l_cell_y = uc_panel.time_y[0];
+  for ( l_index = 0; l_buffer[l_index] != '\0'; l_index++ )
+  {
+    if ( l_time_cells )
+    {
+      l_cell_x = uc_panel.time_x[l_index];
+      l_cell_y = uc_panel.time_y[l_index];
+    }
+    if ( l_blink && ( l_buffer[l_index] == ':' ) && ( l_redrawn & ( 1UL << l_index ) ) && 
+         ( l_cell_x >= 0 ) && ( l_cell_x < UC_PANEL_WIDTH ) )
+    {
+      display_draw_pixel( m_black_pen, l_cell_x, l_cell_y + 2 );
+      display_draw_pixel( m_black_pen, l_cell_x, l_cell_y + 4 );
+    }
+    l_cell_x += display_glyph_width( l_buffer[l_index] );
+  }
+
+  /*
+   * The gradient background changes based on the current time of day,
+   * with a nice fade into the centre.
+   */
+  l_midday_percent = display_calc_midday_percent( p_time );
+  display_update_gradient( l_midday_percent );
+
+  /* Only redraw the columns whose colour has changed. */
+  for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+  {
+    if ( m_gradient_pens[l_column] != m_drawn_pens[l_column] )
+    {
+      display_draw_background_column( l_column, m_gradient_pens[l_column] );
+      m_drawn_pens[l_column] = m_gradient_pens[l_column];
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * face_marquee_reset - makes sure that any marquee is prepared afresh.
+ */
+
+static void display_face_marquee_reset( void )
+{
+  m_marquee_active = m_marquee_scrolling = false;
+  return;
+}
+
+
+/*
+ * face_date_render - shows the date; I suppose in the name of being nice to
+ *                    insane nations, we should allow odd formats here. On a
+ *                    panel too narrow for it, the date scrolls through.
+ */
+
+static void display_face_date_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  char                l_buffer[UC_TEXT_MAXLEN+1];
+  uint_fast16_t       l_length;
+  int32_t             l_key;
+  const uc_layout_t  *l_layout;
+
+  /* A scrolling date just keeps going, until it's gone all the way through. */
+  if ( m_marquee_scrolling )
+  {
+    if ( !display_draw_marquee( uc_panel.text_y ) )
+    {
+      m_marquee_scrolling = false;
+      m_face_expired = true;
+    }
+    return;
+  }
+
+  /* Nothing to do unless the date has changed since we drew it. */
+  l_key = ( p_time->year << 9 ) | ( p_time->month << 5 ) | p_time->day;
+  if ( ( m_drawn_text[0] != '\0' ) && ( l_key == m_drawn_key ) )
+  {
+    return;
+  }
+
+  /* Format it appropriately; the format was worked out when it was read. */
+  format_render( &p_config->date_program, p_time, l_buffer, UC_TEXT_MAXLEN, &l_length );
+  l_layout = display_layout_text( l_buffer, l_length );
+
+  /* And just simply draw it. */
+  display_fill_rect( m_black_pen, 0, 0, 
+                     UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+  m_drawn_text[0] = '\0';
+  m_drawn_key = l_key;
+  if ( l_layout->width > (uint_fast16_t)UC_PANEL_WIDTH )
+  {
+    if ( strcmp( l_buffer, m_marquee_text ) != 0 )
+    {
+      display_build_marquee( l_buffer );
+    }
+    m_marquee_start_us = time_us_64();
+    m_marquee_active = m_marquee_scrolling = true;
+    display_draw_marquee( uc_panel.text_y );
+    return;
+  }
+  display_draw_cells( l_buffer, l_layout->x, uc_panel.text_y, false );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * face_timezone_render - shows the current timezone; textual if we have one,
+ *                        but falling back to a simple "UTC+n" if not.
+ */
+
+static void display_face_timezone_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  char                l_buffer[16], l_marquee_buffer[UC_MARQUEE_MAXLEN+1];
+  int32_t             l_key;
+  const uc_layout_t  *l_layout;
+
+  /* The time itself doesn't matter here, only the offset we're showing. */
+  (void)p_time;
+
+  /* First off, grab the timezone to work out what sort of display. */
+  if ( p_config->timezone[0] != '\0' )
+  {
+    /* Pre-render the name when we first show it, and start it moving. */
+    if ( !m_marquee_active )
+    {
+      snprintf( l_marquee_buffer, UC_MARQUEE_MAXLEN, "%s UTC%+d", 
+                p_config->timezone, time_get_utc_offset() / 60 );
+      if ( strcmp( l_marquee_buffer, m_marquee_text ) != 0 )
+      {
+        display_build_marquee( l_marquee_buffer );
+      }
+      m_marquee_start_us = time_us_64();
+      m_marquee_scrolling = ( m_marquee_length > UC_PANEL_WIDTH ) ||
+                            ( strlen( l_marquee_buffer ) > UC_TEXT_MAXLEN );
+      m_marquee_active = true;
+
+      /* Start from a clear display. */
+      display_fill_rect( m_black_pen, 0, 0, 
+                         UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+      m_drawn_text[0] = '\0';
+
+      /* Short names are simply drawn in the middle, once. */
+      if ( !m_marquee_scrolling )
+      {
+        display_draw_cells( l_marquee_buffer, 
+                            ( UC_PANEL_WIDTH - m_marquee_length ) / 2, uc_panel.text_y, false );
+      }
+    }
+
+    if ( m_marquee_scrolling )
+    {
+      /* Long names scroll through, and we're done when they have. */
+      if ( !display_draw_marquee( uc_panel.text_y ) )
+      {
+        m_marquee_scrolling = false;
+        m_face_expired = true;
+      }
+    }
+  }
+  else
+  {
+    /* Then we just show it as an offset, if that's changed since we drew it. */
+    l_key = time_get_utc_offset();
+    if ( ( m_drawn_text[0] == '\0' ) || ( l_key != m_drawn_key ) )
+    {
+      /* Format it, and find out where it goes. */
+      snprintf( l_buffer, 15, "UTC%+d", l_key / 60 );
+      l_layout = display_layout_text( l_buffer, 0 );
+
+      /* And just simply draw it, over a clear display. */
+      display_fill_rect( m_black_pen, 0, 0, 
+                         UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+      m_drawn_text[0] = '\0';
+      display_draw_cells( l_buffer, l_layout->x, uc_panel.text_y, false );
+      m_drawn_key = l_key;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * face_transient_tick - the date and timezone are only shown until their
+ *                       timer runs out, before we go back to the clock; a 
+ *                       scrolling name is always allowed to finish, though.
+ */
+
+static bool display_face_transient_tick( void )
+{
+  /* Marquees keep going until they've scrolled through. */
+  if ( m_marquee_scrolling )
+  {
+    return true;
+  }
+
+  /* Otherwise, it's down to the timer. */
+  return !m_face_expired;
+}
+
+
+/* The faces themselves. */
+
+static const uc_face_t m_face_time = 
+  { "standard", 0, nullptr, display_face_time_render, nullptr, nullptr };
+static const uc_face_t m_face_date = 
+  { "date", 0, display_face_marquee_reset, display_face_date_render, 
+    display_face_transient_tick, display_face_marquee_reset };
+static const uc_face_t m_face_timezone = 
+  { "timezone", 0, display_face_marquee_reset, display_face_timezone_render, 
+    display_face_transient_tick, display_face_marquee_reset };
+
+/* And the clock faces that the user can choose between. */
+
+static const uc_face_t *m_clock_faces[] = 
+  { &m_face_time, &uc_face_large, &uc_face_binary, &uc_face_progress, &uc_face_seconds };
+
+
+#ifndef NDEBUG
+/*
+ * float_midday_percent - the original floating point version of
+ *                        calc_midday_percent, kept for the self test to
+ *                        check the integer one against.
+ */
+
+static int display_float_midday_percent( uint32_t p_secs_in_day )
+{
+  float           l_day_percent, l_midday_percent;
+
+  /* Calculate what percent of the day that represents. */
+  l_day_percent = p_secs_in_day / 86400.0f;
+
+  /* And finally, translate that to how close to midday we are. */
+  l_midday_percent = 1.0f - ( ( cos( l_day_percent * 3.14159 * 2 ) + 1 ) / 2 );
+
+  /* All done! Work out which bucket we fall into. */
+  return l_midday_percent * UC_GRADIENT_STEPS;
+}
+
+
+/*
+ * float_gradient_colour - the original floating point version of
+ *                         gradient_colour, likewise.
+ */
+
+static uint32_t display_float_gradient_colour( float p_midday_percent, int p_column )
+{
+  int           l_center_proximity, l_midpoint;
+  float         l_hue, l_sat, l_val;
+  uint_fast8_t  l_red, l_green, l_blue;
+  float         i, f;
+  uint_fast8_t  p, q, t;
+
+  /* Work out the base HSV values. */
+  l_hue = ( ( UC_HUE_MIDDAY - UC_HUE_MIDNIGHT ) * p_midday_percent ) + UC_HUE_MIDNIGHT;
+  l_sat = ( ( UC_SAT_MIDDAY - UC_SAT_MIDNIGHT ) * p_midday_percent ) + UC_SAT_MIDNIGHT;
+  l_val = ( ( UC_VAL_MIDDAY - UC_VAL_MIDNIGHT ) * p_midday_percent ) + UC_VAL_MIDNIGHT;
+
+  /* The hue then varies based on the column. */
+  l_midpoint = UC_PANEL_WIDTH / 2;
+  l_center_proximity = l_midpoint - abs( p_column - l_midpoint );
+  l_hue += ( UC_HUE_OFFSET * l_center_proximity / l_midpoint );
+
+  /* Pimoroni's HSV to RGB conversion. */
+  i = floor( l_hue * 6.0f );
+  f = l_hue * 6.0f - i;
+  l_val *= 255.0f;
+  p = l_val * ( 1.0f - l_sat );
+  q = l_val * ( 1.0f - f * l_sat );
+  t = l_val * ( 1.0f - (1.0f - f) * l_sat );
+
+  switch( int( i ) % 6 ) 
+  {
+    case 0: l_red = l_val;  l_green = t;      l_blue = p;     break;
+    case 1: l_red = q;      l_green = l_val;  l_blue = p;     break;
+    case 2: l_red = p;      l_green = l_val;  l_blue = t;     break;
+    case 3: l_red = p;      l_green = q;      l_blue = l_val; break;
+    case 4: l_red = t;      l_green = p;      l_blue = l_val; break;
+    default:
+    case 5: l_red = l_val;  l_green = p;      l_blue = q;     break;    
+  }
+
+  /* All done. */
+  return ( l_red << 16 ) | ( l_green << 8 ) | l_blue;
+}
+
+
+/*
+ * check_gradient - compares the integer gradient code against the float
+ *                  version it replaced; every colour must be identical, but
+ *                  the cosine table can put the odd second of the day into
+ *                  the neighbouring bucket.
+ */
+
+static bool display_check_gradient( void )
+{
+  datetime_t      l_time;
+  uint32_t        l_secs, l_colour_matches = 0, l_bucket_matches = 0;
+  uint_fast16_t   l_bucket;
+  int             l_column, l_difference, l_worst = 0;
+
+  /* Every second of the day must land in (or next to) the same bucket. */
+  for ( l_secs = 0; l_secs < 86400; l_secs++ )
+  {
+    l_time.hour = l_secs / 3600;
+    l_time.min = ( l_secs / 60 ) % 60;
+    l_time.sec = l_secs % 60;
+    l_difference = abs( (int)display_calc_midday_percent( &l_time ) - display_float_midday_percent( l_secs ) );
+    if ( l_difference == 0 )
+    {
+      l_bucket_matches++;
+    }
+    if ( l_difference > l_worst )
+    {
+      l_worst = l_difference;
+    }
+  }
+
+  /* And every bucket must give the same colour, in every column. */
+  for ( l_bucket = 0; l_bucket <= UC_GRADIENT_STEPS; l_bucket++ )
+  {
+    for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+    {
+      if ( display_gradient_colour( l_bucket, l_column ) == 
+           display_float_gradient_colour( (float)l_bucket / UC_GRADIENT_STEPS, l_column ) )
+      {
+        l_colour_matches++;
+      }
+    }
+  }
+
+  /* Report what we found. */
+  usb_debug( "gradient buckets %" PRIu32 "/86400 match, worst %d", l_bucket_matches, l_worst );
+  usb_debug( "gradient colours %" PRIu32 "/%" PRIu32 " match", 
+             l_colour_matches, (uint32_t)( ( UC_GRADIENT_STEPS + 1 ) * UC_PANEL_WIDTH ) );
+  return ( l_worst <= 1 ) && ( l_colour_matches == ( UC_GRADIENT_STEPS + 1 ) * UC_PANEL_WIDTH );
+}
+
+
+/*
+ * bench_kernel - times working out a full set of gradient colours, from the
+ *                time of day, with the integer code and with the float code
+ *                it replaced.
+ */
+
+static void display_bench_kernel( void )
+{
+  datetime_t          l_time;
+  uint32_t            l_start, l_elapsed[2], l_secs;
+  volatile uint32_t   l_sink = 0;
+  uint_fast8_t        l_pass;
+  uint_fast16_t       l_rebuild, l_bucket;
+  int                 l_column;
+
+  /* Work through a spread of times of day, building every column for each. */
+  for ( l_pass = 0; l_pass < 2; l_pass++ )
+  {
+    l_start = time_us_32();
+    for ( l_rebuild = 0; l_rebuild < UC_BENCH_FRAMES; l_rebuild++ )
+    {
+      l_secs = ( l_rebuild * 86399UL ) / UC_BENCH_FRAMES;
+      l_time.hour = l_secs / 3600;
+      l_time.min = ( l_secs / 60 ) % 60;
+      l_time.sec = l_secs % 60;
+      if ( l_pass == 0 )
+      {
+        l_bucket = display_calc_midday_percent( &l_time );
+        for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+        {
+          l_sink += display_gradient_colour( l_bucket, l_column );
+        }
+      }
+      else
+      {
+        l_bucket = display_float_midday_percent( l_secs );
+        for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+        {
+          l_sink += display_float_gradient_colour( (float)l_bucket / UC_GRADIENT_STEPS, l_column );
+        }
+      }
+    }
+    l_elapsed[l_pass] = time_us_32() - l_start;
+  }
+
+  /* Report what we found; the sink is only there so the work isn't skipped. */
+  usb_debug( "kernel %d builds int=%" PRIu32 "us float=%" PRIu32 "us", 
+             UC_BENCH_FRAMES, l_elapsed[0], l_elapsed[1] );
+  return;
+}
+
+/*
+ * bench_gradient - times rendering the clock face in full, with the gradient
+ *                  pens cached as normal, and with them built every frame as
+ *                  they were before there was a cache; the float code works
+ *                  out each column's colour, and PicoGraphics makes a pen of
+ *                  it. The passes take turns over a few rounds, and the best
+ *                  round of each is reported, to keep the figures steady.
+ */
+
+static void display_bench_gradient( const uc_config_t *p_config )
+{
+  uc_config_t     l_config;
+  datetime_t      l_time;
+  uint32_t        l_start, l_elapsed, l_best[2], l_colour;
+  uint_fast8_t    l_round, l_pass;
+  uint_fast16_t   l_frame;
+  int             l_bucket, l_column;
+
+  /* A fixed time, with nothing moving. */
+  l_config = *p_config;
+  l_config.animate = false;
+  l_time.year = 2023;
+  l_time.month = 6;
+  l_time.day = 21;
+  l_time.dotw = 3;
+  l_time.hour = 10;
+  l_time.min = 30;
+  l_time.sec = 0;
+  time_override( &l_time );
+  m_face = &m_face_time;
+  m_face_expired = false;
+  m_brightness_display = false;
+  l_best[0] = l_best[1] = UINT32_MAX;
+
+  /* Render the whole frame each time, the second pass building the pens too. */
+  for ( l_round = 0; l_round < UC_BENCH_ROUNDS; l_round++ )
+  {
+    for ( l_pass = 0; l_pass < 2; l_pass++ )
+    {
+      l_start = time_us_32();
+      for ( l_frame = 0; l_frame < UC_BENCH_FRAMES; l_frame++ )
+      {
+        if ( l_pass == 1 )
+        {
+          l_bucket = display_float_midday_percent( ( ( l_time.hour * 60 ) + l_time.min ) * 60 + l_time.sec );
+          for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+          {
+            l_colour = display_float_gradient_colour( (float)l_bucket / UC_GRADIENT_STEPS, l_column );
+#ifdef UC_FRAMEBUFFER_P8
+            /* Palette entries can't be made afresh each frame; just change them. */
+            m_graphics->update_pen( UC_GRADIENT_PEN_BASE + l_column, 
+                                    l_colour >> 16, ( l_colour >> 8 ) & 0xff, l_colour & 0xff );
+#else
+            m_gradient_pens[l_column] = m_graphics->create_pen( l_colour >> 16, ( l_colour >> 8 ) & 0xff, 
+                                                                l_colour & 0xff );
+#endif
+          }
+          m_gradient_bucket = l_bucket;
+        }
+        m_frame_valid = false;
+        display_render( &l_config );
+      }
+      l_elapsed = time_us_32() - l_start;
+      if ( l_elapsed < l_best[l_pass] )
+      {
+        l_best[l_pass] = l_elapsed;
+      }
+    }
+  }
+
+  /* Report the best of each, per frame. */
+  usb_debug( "gradient per frame cached=%" PRIu32 ".%02" PRIu32 "us built=%" PRIu32 ".%02" PRIu32 "us", 
+             l_best[0] / UC_BENCH_FRAMES, ( ( l_best[0] % UC_BENCH_FRAMES ) * 100 ) / UC_BENCH_FRAMES,
+             l_best[1] / UC_BENCH_FRAMES, ( ( l_best[1] % UC_BENCH_FRAMES ) * 100 ) / UC_BENCH_FRAMES );
+  return;
+}
+
+/*
+ * bench_fill - times filling the whole panel, first a pixel at a time through
+ *              PicoGraphics as the background used to be drawn, and then a
+ *              span at a time with fill_rect.
+ */
+
+static void display_bench_fill( void )
+{
+  uint32_t        l_start, l_elapsed[2], l_pixels;
+  uint_fast8_t    l_pass;
+  uint_fast16_t   l_frame;
+  int32_t         l_x, l_y;
+
+  /* Fill the panel over and over, alternating pens so nothing is skipped. */
+  for ( l_pass = 0; l_pass < 2; l_pass++ )
+  {
+    l_start = time_us_32();
+    for ( l_frame = 0; l_frame < UC_BENCH_FRAMES; l_frame++ )
+    {
+      if ( l_pass == 0 )
+      {
+        m_graphics->set_pen( ( l_frame & 1 ) ? m_white_pen : m_black_pen );
+        for ( l_y = 0; l_y < UC_PANEL_HEIGHT; l_y++ )
+        {
+          for ( l_x = 0; l_x < UC_PANEL_WIDTH; l_x++ )
+          {
+            m_graphics->pixel( pimoroni::Point( l_x, l_y ) );
+          }
+        }
+      }
+      else
+      {
+        display_fill_rect( ( l_frame & 1 ) ? m_white_pen : m_black_pen, 
+                           0, 0, UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+      }
+    }
+    l_elapsed[l_pass] = time_us_32() - l_start;
+    if ( l_elapsed[l_pass] == 0 )
+    {
+      l_elapsed[l_pass] = 1;
+    }
+  }
+
+  /* Report the rates, in pixels per microsecond to two places. */
+  l_pixels = UC_BENCH_FRAMES * UC_PANEL_WIDTH * UC_PANEL_HEIGHT;
+  usb_debug( "fill %" PRIu32 " pixels pixel=%" PRIu32 ".%02" PRIu32 "px/us span=%" PRIu32 ".%02" PRIu32 "px/us", 
+             l_pixels, 
+             l_pixels / l_elapsed[0], ( ( l_pixels % l_elapsed[0] ) * 100 ) / l_elapsed[0],
+             l_pixels / l_elapsed[1], ( ( l_pixels % l_elapsed[1] ) * 100 ) / l_elapsed[1] );
+  return;
+}
+
+/*
+ * bench_roll - times the frames of the rolling digit animation, as the render
+ *              loop would; each render and push, every UC_ANIMATE_FRAME_MS,
+ *              through a few times where every digit rolls at once. The
+ *              frame budget is not applied, so that we see the worst case.
+ */
+
+static void display_bench_roll( const uc_config_t *p_config )
+{
+  static const uint8_t  l_hours[] = { 9, 19, 23 };
+  uc_config_t     l_config;
+  datetime_t      l_time;
+  absolute_time_t l_next_frame;
+  uint32_t        l_start, l_elapsed, l_max = 0, l_total = 0, l_count = 0, l_over = 0;
+  uint_fast8_t    l_index;
+  bool            l_suspended;
+
+  /* Animation on, whatever the budget monitor thinks. */
+  l_config = *p_config;
+  l_config.animate = true;
+  l_suspended = m_animation_suspended;
+  m_animation_suspended = false;
+  m_face = &m_face_time;
+  m_face_expired = false;
+  m_brightness_display = false;
+  l_time.year = 2023;
+  l_time.month = 6;
+  l_time.day = 21;
+  l_time.dotw = 3;
+
+  for ( l_index = 0; l_index < sizeof( l_hours ); l_index++ )
+  {
+    /* Draw the second before the hour, with nothing rolling. */
+    l_time.hour = l_hours[l_index];
+    l_time.min = l_time.sec = 59;
+    time_override( &l_time );
+    m_frame_valid = false;
+    display_render( &l_config );
+    display_push();
+
+    /* Then tick over to the hour, and follow the roll all the way through. */
+    l_time.hour = ( l_hours[l_index] + 1 ) % 24;
+    l_time.min = l_time.sec = 0;
+    time_override( &l_time );
+    do
+    {
+      l_next_frame = make_timeout_time_ms( UC_ANIMATE_FRAME_MS );
+      l_start = time_us_32();
+      if ( display_render( &l_config ) )
+      {
+        display_push();
+      }
+      l_elapsed = time_us_32() - l_start;
+      if ( l_elapsed > l_max )
+      {
+        l_max = l_elapsed;
+      }
+      if ( l_elapsed > UC_FRAME_BUDGET_US )
+      {
+        l_over++;
+      }
+      l_total += l_elapsed;
+      l_count++;
+      while ( !time_reached( l_next_frame ) )
+      {
+        tight_loop_contents();
+      }
+    } while ( m_roll_cells != 0 );
+  }
+
+  /* Report what we found, and put the budget monitor back as it was. */
+  usb_debug( "roll n=%" PRIu32 " avg=%" PRIu32 "us max=%" PRIu32 "us over %dus=%" PRIu32, 
+             l_count, l_total / l_count, l_max, UC_FRAME_BUDGET_US, l_over );
+  m_animation_suspended = l_suspended;
+  return;
+}
+
+
+/*
+ * dump_frame - sends the current framebuffer out over the debug channel, as a
+ *              binary PPM image; the label goes in a comment, so that the
+ *              host can tell one frame from another.
+ */
+
+static void display_dump_frame( const char *p_label )
+{
+  char             l_header[64];
+  uint8_t          l_row[UC_PANEL_WIDTH*3];
+  const uc_pixel_t *l_pixel;
+  uint16_t         l_rgb;
+  uint_fast8_t     l_x, l_y, l_level;
+  int              l_length;
+
+  /* The header is simple enough. */
+  l_length = snprintf( l_header, sizeof( l_header ), "P6\n# %s\n%d %d\n255\n", p_label,
+                       UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+  usb_debug_write( l_header, l_length );
+
+  /* And then each row, expanded out into 8 bit RGB. */
+  l_pixel = (const uc_pixel_t *)m_graphics->frame_buffer;
+  for ( l_y = 0; l_y < UC_PANEL_HEIGHT; l_y++ )
+  {
+    for ( l_x = 0; l_x < UC_PANEL_WIDTH; l_x++ )
+    {
+#ifdef UC_FRAMEBUFFER_P8
+      /* Pens are palette entries, so look up the colour. */
+      l_rgb = ( (pimoroni::PicoGraphics_PenP8 *)m_graphics )->palette[*l_pixel++].to_rgb565();
+#else
+      /* Pens are already RGB565. */
+      l_rgb = *l_pixel++;
+#endif
+
+      /* Which is held byte-swapped, ready for the display. */
+      l_rgb = __builtin_bswap16( l_rgb );
+      l_level = ( l_rgb >> 11 ) & 0x1f;
+      l_row[l_x*3] = ( l_level << 3 ) | ( l_level >> 2 );
+      l_level = ( l_rgb >> 5 ) & 0x3f;
+      l_row[l_x*3+1] = ( l_level << 2 ) | ( l_level >> 4 );
+      l_level = l_rgb & 0x1f;
+      l_row[l_x*3+2] = ( l_level << 3 ) | ( l_level >> 2 );
+    }
+    usb_debug_write( l_row, sizeof( l_row ) );
+  }
+
+  /* All done. */
+  return;
+}
+#endif
+
+
+/*
+ * show_transient - switches to a transient display, and sets the timer for
+ *                  how long it's shown. The whole frame is redrawn, even if
+ *                  it was already showing, so that it starts afresh; going
+ *                  back to the clock does the same.
+ */
+
+static void display_show_transient( const uc_face_t *p_face, uint32_t p_ms )
+{
+  m_face = p_face;
+  m_face_expired = false;
+  display_timer_arm( UC_TIMER_FACE, p_ms );
+  m_frame_valid = false;
+  return;
+}
+
+
+/* Functions.*/
+
+/*
+ * read - attempts to read the configuration file; if it doesn't exist, it 
+ *        will be created with some reasonable defaults. Returns a time/size
+ *        stamp that can be used to identify when the file is changed.
+ */
+
+/*
+ * init - sets up the display handling.
+ */
+
+void display_init( uc_unicorn_t *p_unicorn, pimoroni::PicoGraphics *p_graphics )
+{
+  uint_fast8_t  l_index, l_level;
+
+  /* Keep a reference to the graphics and the board. */
+  m_unicorn = p_unicorn;
+  m_graphics = p_graphics;
+
+  /* Create our black and white pens. */
+  memset( m_pen_keys, 0, sizeof( m_pen_keys ) );
+  m_pen_hits = m_pen_misses = 0;
+  m_black_pen = display_intern_pen( 0, 0, 0 );
+  m_white_pen = display_intern_pen( 255, 255, 255 );
+
+  /* And set the font and other basics. */
+  m_graphics->set_font( &clockfont );
+  display_build_atlas();
+
+  /* The marquee shades pixels in steps between black and white. */
+  for ( l_index = 0; l_index <= UC_MARQUEE_SUBSTEPS; l_index++ )
+  {
+    l_level = ( 255 * l_index ) / UC_MARQUEE_SUBSTEPS;
+    m_marquee_pens[l_index] = display_intern_pen( l_level, l_level, l_level );
+  }
+
+#ifdef UC_FRAMEBUFFER_P8
+  /*
+   * With a palette, the gradient columns get a fixed entry each; these are
+   * claimed after the fixed pens, so that they never share an entry.
+   */
+  for ( l_index = 0; l_index < UC_PANEL_WIDTH; l_index++ )
+  {
+    m_graphics->update_pen( UC_GRADIENT_PEN_BASE + l_index, 0, 0, 0 );
+    m_gradient_pens[l_index] = UC_GRADIENT_PEN_BASE + l_index;
+  }
+  m_palette_changed = false;
+#endif
+
+  display_build_brightness_lut();
+  m_brightness_level = m_brightness_level_target = ( UC_BRIGHTNESS_LEVELS / 2 ) << 8;
+  m_brightness_target = m_brightness_lut[UC_BRIGHTNESS_LEVELS/2];
+  m_brightness_step = 0;
+  m_dither_error = 0;
+  m_dithering = false;
+  display_apply_brightness();
+  m_brightness_display = m_face_expired = false;
+  m_timer_count = 0;
+  m_clock_face = 0;
+  m_face = m_clock_faces[m_clock_face];
+  m_drawn_face = nullptr;
+
+  /* Flag the gradient cache as empty, so it's built on the first render. */
+  m_gradient_bucket = -1;
+
+  /* And make sure the first frame is drawn in full. */
+  m_frame_valid = false;
+  memset( m_layers, 0, sizeof( m_layers ) );
+  m_damage.width = m_damage.height = 0;
+  m_output_damage.width = m_output_damage.height = 0;
+  m_push_all = true;
+  m_push_lit = false;
+  m_frames_rendered = m_frames_pushed = 0;
+  m_total_pixels = 0;
+  m_worst_frame_us = 0;
+
+  /* Nothing is animating yet. */
+  m_roll_cells = 0;
+  m_marquee_text[0] = '\0';
+  m_marquee_length = 0;
+  m_marquee_active = m_marquee_scrolling = false;
+  m_frame_overruns = 0;
+  m_frame_animated = m_animation_suspended = false;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render - draws the current face onto the provided graphics context. Faces
+ *          keep track of what was drawn last time, and only redraw the parts
+ *          of the display that have changed; returns true if anything was
+ *          drawn, and the display therefore needs updating.
+ */
+
+bool display_render( const uc_config_t *p_config )
+{
+  datetime_t      l_time;
+  uint_fast8_t    l_index, l_column, l_bar_height;
+
+  /* Start counting the pixels we touch in this frame. */
+  m_frame_pixels = 0;
+  m_palette_changed = false;
+  m_frame_animated = false;
+
+  /* Let any transient displays that have run their course expire. */
+  display_timer_expire();
+  if ( ( m_face->tick != nullptr ) && !m_face->tick() )
+  {
+    m_face = m_clock_faces[m_clock_face];
+    m_frame_valid = false;
+  }
+
+  /* Work out how much of the brightness bar we need, if any. */
+  l_bar_height = 0;
+  if ( m_brightness_display )
+  {
+    for ( l_index = 0; l_index < UC_PANEL_HEIGHT; l_index++ )
+    {
+      if ( l_index <= ( ( m_brightness_level_target >> 8 ) * UC_PANEL_HEIGHT ) / ( UC_BRIGHTNESS_LEVELS - 1 ) )
+      {
+        l_bar_height++;
+      }
+    }
+  }
+
+  /* A change of face means that everything needs redrawing. */
+  if ( m_face != m_drawn_face )
+  {
+    if ( ( m_drawn_face != nullptr ) && ( m_drawn_face->exit != nullptr ) )
+    {
+      m_drawn_face->exit();
+    }
+    m_frame_valid = false;
+  }
+
+  /* If we're redrawing everything, start with a clean slate. */
+  if ( !m_frame_valid )
+  {
+    display_fill_rect( m_black_pen, 0, 0, 
+                       UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+    m_drawn_text[0] = '\0';
+    m_roll_cells = 0;
+    for ( l_column = 0; l_column < UC_PANEL_WIDTH; l_column++ )
+    {
+      m_drawn_pens[l_column] = m_black_pen;
+    }
+    if ( m_face->enter != nullptr )
+    {
+      m_face->enter();
+    }
+    m_drawn_face = m_face;
+    m_frame_valid = true;
+  }
+
+  /* Now let the face draw itself. */
+  time_get_datetime( &l_time );
+  m_face->render( p_config, &l_time );
+
+  /* 
+   * The brightness bar is an overlay, so it never disturbs the face; it only
+   * needs redrawing when it changes size, and the face underneath is left
+   * alone when it does.
+   */
+  if ( l_bar_height != m_layers[UC_LAYER_BRIGHTNESS].bounds.height )
+  {
+    display_layer_fill( UC_LAYER_BRIGHTNESS, m_white_pen, UC_PANEL_WIDTH - 1, 
+                        UC_PANEL_HEIGHT - l_bar_height, 1, l_bar_height );
+    display_layer_show( UC_LAYER_BRIGHTNESS, UC_PANEL_WIDTH - 1, 
+                        UC_PANEL_HEIGHT - l_bar_height, 1, l_bar_height, UC_BRIGHTNESS_ALPHA );
+  }
+
+  /* And put the frame together, from the face and any overlays. */
+  m_frame_pixels += display_compose();
+
+  /* Keep our frame counters up to date. */
+  m_frames_rendered++;
+  m_total_pixels += m_frame_pixels;
+  if ( m_frame_pixels > 0 )
+  {
+    m_frames_pushed++;
+  }
+
+  /* With a palette, changing an entry changes every pixel drawn with it. */
+  if ( m_palette_changed )
+  {
+    m_push_all = true;
+  }
+
+  /* 
+   * If the brightness is ramping or dithering, that moves on every frame; the
+   * new brightness only takes effect when the display is pushed again.
+   */
+  if ( m_brightness_level != m_brightness_level_target )
+  {
+    display_ramp_brightness();
+    if ( display_apply_brightness() )
+    {
+      return true;
+    }
+  }
+  else if ( m_dithering && display_apply_brightness() )
+  {
+    return true;
+  }
+
+  /* All done; the display only needs pushing if we touched any pixels. */
+  return ( m_frame_pixels > 0 ) || m_palette_changed;
+}
+
+
+/*
+ * push - sends the frame out to the Unicorn. Rather than have the Unicorn
+ *        convert the whole framebuffer every time, we hand it just the pixels
+ *        that were composed since the last push. The Unicorn's driver gives us
+ *        no way to rescale what it already holds, so a change of brightness
+ *        means sending every lit pixel again; only a change of palette means
+ *        sending absolutely everything.
+ */
+
+void display_push( void )
+{
+  const uc_pixel_t   *l_output = (const uc_pixel_t *)m_graphics->frame_buffer;
+  uc_pixel_t          l_pen;
+  uc_rect_t           l_damage;
+  uint8_t             l_red, l_green, l_blue;
+  int32_t             l_x, l_y;
+  bool                l_lit_only;
+
+  /* Work out how much needs to go. */
+  l_lit_only = m_push_lit && !m_push_all;
+  l_damage = m_output_damage;
+  if ( m_push_all || m_push_lit )
+  {
+    m_output_damage.x = m_output_damage.y = 0;
+    m_output_damage.width = UC_PANEL_WIDTH;
+    m_output_damage.height = UC_PANEL_HEIGHT;
+    m_push_all = m_push_lit = false;
+  }
+
+  /* And convert each pixel just as the Unicorn would, but only these ones. */
+  for ( l_y = m_output_damage.y; l_y < m_output_damage.y + m_output_damage.height; l_y++ )
+  {
+    for ( l_x = m_output_damage.x; l_x < m_output_damage.x + m_output_damage.width; l_x++ )
+    {
+      l_pen = l_output[( l_y * UC_PANEL_WIDTH ) + l_x];
+#ifdef UC_FRAMEBUFFER_P8
+      /* Pens are palette entries, which the Unicorn sees as full RGB. */
+      const pimoroni::RGB &l_colour = ( (pimoroni::PicoGraphics_PenP8 *)m_graphics )->palette[l_pen];
+      l_red = l_colour.r;
+      l_green = l_colour.g;
+      l_blue = l_colour.b;
+#else
+      /* Pens are byte-swapped RGB565, expanded out the same way the Unicorn does. */
+      l_pen = __builtin_bswap16( l_pen );
+      l_red = ( l_pen & 0xf800 ) >> 8;
+      l_green = ( l_pen & 0x07e0 ) >> 3;
+      l_blue = ( l_pen & 0x001f ) << 3;
+#endif
+
+      /*
+       * A black pixel the Unicorn already has is unaffected by brightness; the
+       * frame's own damage is still sent, as that may have only just gone black.
+       */
+      if ( l_lit_only && ( ( l_red | l_green | l_blue ) == 0 ) &&
+           ( ( l_x < l_damage.x ) || ( l_x >= l_damage.x + l_damage.width ) ||
+             ( l_y < l_damage.y ) || ( l_y >= l_damage.y + l_damage.height ) ) )
+      {
+        continue;
+      }
+      m_unicorn->set_pixel( l_x, l_y, l_red, l_green, l_blue );
+    }
+  }
+  m_output_damage.width = m_output_damage.height = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * take_stats - copies out our frame counters, so that they can be reported
+ *              by the other core; the rendering core never writes to USB.
+ */
+
+void display_take_stats( uc_display_stats_t *p_stats )
+{
+  /* Simply copy the counters. */
+  p_stats->frames_rendered = m_frames_rendered;
+  p_stats->frames_pushed = m_frames_pushed;
+  p_stats->total_pixels = m_total_pixels;
+  p_stats->worst_frame_us = m_worst_frame_us;
+  p_stats->pen_hits = m_pen_hits;
+  p_stats->pen_misses = m_pen_misses;
+
+  /* The worst frame time is just for this reporting period. */
+  m_worst_frame_us = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * report_stats - sends a copy of our frame counters out to the debug channel,
+ *                so we can see how much (or little) work rendering is doing.
+ */
+
+void display_report_stats( const uc_display_stats_t *p_stats )
+{
+  uint32_t  l_lookups = p_stats->pen_hits + p_stats->pen_misses;
+
+  /* Simply report the counters. */
+  usb_debug( "Frames: %" PRIu32 " rendered, %" PRIu32 " pushed", 
+             p_stats->frames_rendered, p_stats->frames_pushed );
+  usb_debug( "Pixels: %" PRIu32 " total, %" PRIu32 " per frame", p_stats->total_pixels, 
+             p_stats->frames_rendered > 0 ? p_stats->total_pixels / p_stats->frames_rendered : 0 );
+  usb_debug( "Worst frame time: %" PRIu32 "us", p_stats->worst_frame_us );
+  usb_debug( "Pens: %" PRIu32 " lookups, %" PRIu32 "%% hit", l_lookups,
+             l_lookups > 0 ? ( p_stats->pen_hits * 100 ) / l_lookups : 0 );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * frame_ms - returns how often we need to be rendered, in milliseconds; zero
+ *            means we only need rendering when the second changes.
+ */
+
+uint32_t display_frame_ms( void )
+{
+  /* Dithering the brightness needs the quickest frames of all. */
+  if ( m_dithering )
+  {
+    return UC_DITHER_FRAME_MS;
+  }
+
+  /* Brightness changes are faded in over a few frames. */
+  if ( m_brightness_level != m_brightness_level_target )
+  {
+    return UC_RAMP_FRAME_MS;
+  }
+
+  /* Animation needs frames as fast as we can manage. */
+  if ( m_roll_cells != 0 )
+  {
+    return UC_ANIMATE_FRAME_MS;
+  }
+
+  /* Scrolling text needs to be kept moving too. */
+  if ( m_marquee_active && m_marquee_scrolling )
+  {
+    return UC_MARQUEE_FRAME_MS;
+  }
+
+  /* Otherwise, it's up to the face; zero means the next second will do. */
+  return m_face->frame_ms;
+}
+
+
+/*
+ * next_deadline - returns when the next transient display timer runs out, so
+ *                 that we can be rendered right then, whatever the frame rate
+ *                 happens to be.
+ */
+
+absolute_time_t display_next_deadline( void )
+{
+  /* The queue is kept in order, so it's always the first one. */
+  if ( m_timer_count == 0 )
+  {
+    return at_the_end_of_time;
+  }
+  return m_timers[0].deadline;
+}
+
+
+/*
+ * frame_time - told how long the last frame took to render and push out to
+ *              the display. If animated frames keep going over budget, we
+ *              suspend the animation for a while, falling back to static
+ *              rendering so that we don't starve everything else. Returns
+ *              true if that has just happened, so the caller can report it.
+ */
+
+bool display_frame_time( uint32_t p_frame_us )
+{
+  /* Keep track of the worst case, for reporting. */
+  if ( p_frame_us > m_worst_frame_us )
+  {
+    m_worst_frame_us = p_frame_us;
+  }
+
+  /* Only animated frames are held to the budget. */
+  if ( !m_frame_animated )
+  {
+    return false;
+  }
+
+  /* Count up consecutive overruns. */
+  if ( p_frame_us <= UC_FRAME_BUDGET_US )
+  {
+    m_frame_overruns = 0;
+    return false;
+  }
+  m_frame_overruns++;
+
+  /* And if there are too many, give it a rest for a while. */
+  if ( m_frame_overruns >= UC_FRAME_OVERRUNS )
+  {
+    m_animation_suspended = true;
+    m_animation_resume = make_timeout_time_ms( UC_ANIMATE_BACKOFF_MS );
+    m_frame_overruns = 0;
+    return true;
+  }
+
+  /* All done. */
+  return false;
+}
+
+
+/*
+ * set_brightness - sets the brightness level we want to be at; core0 works
+ *                  this out from the ambient light and the brightness curve.
+ *                  Any change is faded in over the next few frames.
+ */
+
+void display_set_brightness( uint8_t p_level )
+{
+  /* Sanity check that it's not too low. */
+  if ( p_level < UC_BRIGHTNESS_FLOOR )
+  {
+    p_level = UC_BRIGHTNESS_FLOOR;
+  }
+
+  /* Good; now set that as the level to ramp towards. */
+  m_brightness_level_target = p_level << 8;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * show_brightness - the user has changed the brightness, so we show them the
+ *                   new level for a little while.
+ */
+
+void display_show_brightness( void )
+{
+  /* Turn on the brightness bar, and set the display timer. */
+  m_brightness_display = true;
+  display_timer_arm( UC_TIMER_BRIGHTNESS, UC_BRIGHTNESS_SHOW_MS );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * timezone - show the currently set timezone, for a period of time.
+ */
+
+void display_timezone( void )
+{
+  display_show_transient( &m_face_timezone, UC_TIMEZONE_SHOW_MS );
+  return;
+}
+
+
+/*
+ * date - show the current date, for a period of time.
+ */
+
+void display_date( void )
+{
+  display_show_transient( &m_face_date, UC_DATE_SHOW_MS );
+  return;
+}
+
+
+/*
+ * set_face - selects the clock face to show, by name; unknown names leave
+ *            the current face alone. Unless asked to show it right now, a
+ *            transient display is left to run its course first.
+ */
+
+void display_set_face( const char *p_name, bool p_now )
+{
+  uint_fast8_t  l_index;
+
+  /* Look for the face by name. */
+  for ( l_index = 0; l_index < UC_FACE_COUNT; l_index++ )
+  {
+    if ( strcmp( m_clock_faces[l_index]->name, p_name ) == 0 )
+    {
+      /* Only switch straight over if we're showing the clock right now. */
+      if ( p_now || ( m_face == m_clock_faces[m_clock_face] ) )
+      {
+        m_face = m_clock_faces[l_index];
+      }
+      m_clock_face = l_index;
+      break;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * next_face - moves the configuration on to the next clock face, and saves
+ *             the choice; this only looks at the list of faces, so is safe
+ *             to call from core0, which then passes the change on to core1.
+ */
+
+void display_next_face( uc_config_t *p_config )
+{
+  uint_fast8_t  l_index;
+
+  /* Find the face we're on now; an unknown one counts as the first. */
+  for ( l_index = UC_FACE_COUNT - 1; l_index > 0; l_index-- )
+  {
+    if ( strcmp( m_clock_faces[l_index]->name, p_config->face ) == 0 )
+    {
+      break;
+    }
+  }
+
+  /* Step on to the next face, wrapping round at the end, and remember it. */
+  l_index = ( l_index + 1 ) % UC_FACE_COUNT;
+  strncpy( p_config->face, m_clock_faces[l_index]->name, UC_FACE_MAXLEN );
+  p_config->face[UC_FACE_MAXLEN] = '\0';
+  config_write( p_config );
+
+  /* All done. */
+  return;
+}
+
+
+#ifndef NDEBUG
+/*
+ * golden_frames - renders every display mode across a sweep of times of day,
+ *                 sending each frame out as a PPM along with a timing report.
+ *                 This gives us reference frames to compare against when the
+ *                 rendering changes, and a repeatable benchmark.
+ */
+
+void display_golden_frames( const uc_config_t *p_config )
+{
+  static const uc_face_t *l_scene_faces[] = 
+    { &m_face_time, &uc_face_large, &uc_face_binary, &uc_face_progress, 
+      &uc_face_seconds, &m_face_date, &m_face_timezone, &m_face_time };
+  uc_config_t     l_config;
+  datetime_t      l_time;
+  char            l_label[32];
+  uint_fast8_t    l_scene;
+  uint_fast16_t   l_minutes;
+  uint32_t        l_start, l_elapsed, l_min, l_max, l_total, l_count;
+
+  /* Animation would make frames depend on timing, so turn it off. */
+  l_config = *p_config;
+  l_config.animate = false;
+
+  /* Likewise, don't let any pending timers cut a scene short. */
+  m_timer_count = 0;
+
+  /* And use a fixed date, so that the frames are the same every time. */
+  l_time.year = 2023;
+  l_time.month = 6;
+  l_time.day = 21;
+  l_time.dotw = 3;
+
+  /* Work through each scene in turn. */
+  for ( l_scene = 0; l_scene < UC_GOLDEN_SCENES; l_scene++ )
+  {
+    l_min = UINT32_MAX;
+    l_max = l_total = l_count = 0;
+
+    for ( l_minutes = 0; l_minutes < 24 * 60; l_minutes += UC_GOLDEN_STEP_MINS )
+    {
+      /* Vary the seconds as well, so that we see both sides of the blink. */
+      l_time.hour = l_minutes / 60;
+      l_time.min = l_minutes % 60;
+      l_time.sec = ( l_minutes / UC_GOLDEN_STEP_MINS ) % 60;
+      time_override( &l_time );
+
+      /* Set up the scene, and make sure it's drawn from scratch. */
+      m_face = l_scene_faces[l_scene];
+      m_face_expired = false;
+      m_brightness_display = ( l_scene == UC_GOLDEN_SCENES - 1 );
+      m_frame_valid = false;
+
+      /* Render it, timing how long that takes. */
+      l_start = time_us_32();
+      display_render( &l_config );
+      l_elapsed = time_us_32() - l_start;
+      if ( l_elapsed < l_min )
+      {
+        l_min = l_elapsed;
+      }
+      if ( l_elapsed > l_max )
+      {
+        l_max = l_elapsed;
+      }
+      l_total += l_elapsed;
+      l_count++;
+
+      /* And send it off. */
+      snprintf( l_label, sizeof( l_label ), "%s%s %02d:%02d:%02d", m_face->name, 
+                ( l_scene == UC_GOLDEN_SCENES - 1 ) ? "+overlay" : "", 
+                l_time.hour, l_time.min, l_time.sec );
+      display_dump_frame( l_label );
+    }
+
+    /* Report the timings for this scene. */
+    usb_debug( "%-8s n=%" PRIu32 " min=%" PRIu32 " avg=%" PRIu32 " max=%" PRIu32, l_scene_faces[l_scene]->name, 
+               l_count, l_min, l_total / l_count, l_max );
+  }
+
+  /* Back to the real time, and a clean slate. */
+  time_override( nullptr );
+  m_face = m_clock_faces[m_clock_face];
+  m_brightness_display = false;
+  m_frame_valid = false;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * self_test - checks the rendering code against what it replaced, and times
+ *             how quickly the heavier parts of it run, sending the results
+ *             out over the debug channel. Returns true if all the checks
+ *             passed.
+ */
+
+bool display_self_test( const uc_config_t *p_config )
+{
+  bool            l_passed = true;
+
+  /* The gradient colours must be just what the float code gave. */
+  if ( !display_check_gradient() )
+  {
+    l_passed = false;
+  }
+
+  /* Time the integer gradient code against the float code. */
+  display_bench_kernel();
+
+  /* Time how much the gradient cache saves. */
+  display_bench_gradient( p_config );
+
+  /* How much faster spans are than PicoGraphics' pixels. */
+  display_bench_fill();
+
+  /* And the worst frame time with the digits rolling. */
+  display_bench_roll( p_config );
+
+  /* Back to the real time, and a clean slate. */
+  time_override( nullptr );
+  m_face = m_clock_faces[m_clock_face];
+  m_frame_valid = false;
+
+  /* And say how that all went. */
+  usb_debug( "self test %s", l_passed ? "passed" : "FAILED" );
+  return l_passed;
 }
+#endif
 
 
 /* End of file display.cpp */
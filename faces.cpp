@@ -0,0 +1,317 @@
+/*
+ * faces.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Alternative clock faces; each face is a small table of functions, which 
+ * the display code calls as required. Faces draw straight into the display
+ * using the primitives in display.cpp, and like everything else only redraw
+ * what has changed since the last frame.
+ * 
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+
+
+/* Module variables. */
+
+static int          m_face_black_pen, m_face_white_pen, m_face_dim_pen, m_face_fill_pen;
+static char         m_large_drawn[8];
+static bool         m_large_blink;
+static int8_t       m_binary_drawn[6];
+static int          m_progress_drawn;
+static int          m_seconds_drawn, m_sweep_drawn;
+static uc_format_t  m_large_program, m_seconds_program;
+
+
+/* Local functions. */
+
+/*
+ * create_pens - fetches the pens that the faces share.
+ */
+
+static void faces_create_pens( void )
+{
+  m_face_black_pen = display_intern_pen( 0, 0, 0 );
+  m_face_white_pen = display_intern_pen( 255, 255, 255 );
+  m_face_dim_pen = display_intern_pen( 40, 40, 40 );
+  m_face_fill_pen = display_intern_pen( 255, 128, 0 );
+  return;
+}
+
+
+/*
+ * large_enter - prepares the large HH:MM face.
+ */
+
+static void faces_large_enter( void )
+{
+  faces_create_pens();
+  format_compile( "HM", ':', nullptr, &m_large_program );
+
+  /* The display has just been cleared, so nothing we drew is there now. */
+  memset( m_large_drawn, 0, sizeof( m_large_drawn ) );
+  m_large_blink = false;
+  return;
+}
+
+
+/*
+ * large_render - hours and minutes only, but stretched to fill the display;
+ *                on narrow panels, the hours go above the minutes instead.
+ */
+
+static void faces_large_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  char          l_buffer[8];
+  bool          l_blink;
+  uint_fast8_t  l_index, l_row;
+  int32_t       l_width, l_x;
+
+  /* Format the time, and work out how wide a row of it will be. */
+  format_render( &m_large_program, p_time, l_buffer, 7, nullptr );
+  l_width = 0;
+  for ( l_index = 0; l_buffer[l_index] != '\0'; l_index++ )
+  {
+    if ( ( uc_panel.large_rows == 1 ) || ( l_index < 2 ) )
+    {
+      l_width += display_glyph_width( l_buffer[l_index] ) * uc_panel.large_scale;
+    }
+  }
+
+  /* The separator blinks, so needs redrawing when that changes. */
+  l_blink = ( ( p_time->sec & 1 ) == 0 );
+  if ( l_blink != m_large_blink )
+  {
+    m_large_drawn[2] = ' ';
+    m_large_blink = l_blink;
+  }
+
+  /* Centre it, ignoring the spacing after the last digit. */
+  l_x = ( UC_PANEL_WIDTH - 1 - ( l_width - uc_panel.large_scale ) ) / 2;
+
+  /* And draw any characters that have changed; two rows lose the separator. */
+  l_row = 0;
+  for ( l_index = 0; l_buffer[l_index] != '\0'; l_index++ )
+  {
+    if ( ( uc_panel.large_rows > 1 ) && ( l_index == 2 ) )
+    {
+      l_x = ( UC_PANEL_WIDTH - 1 - ( l_width - uc_panel.large_scale ) ) / 2;
+      l_row = 1;
+      continue;
+    }
+    if ( l_buffer[l_index] != m_large_drawn[l_index] )
+    {
+      display_blit_scaled_glyph( l_buffer[l_index], l_x, uc_panel.large_y[l_row], uc_panel.large_scale, 
+                                 uc_panel.large_height,
+                                 ( l_blink && ( l_buffer[l_index] == ':' ) ) ? m_face_black_pen : m_face_white_pen,
+                                 m_face_black_pen );
+    }
+    l_x += display_glyph_width( l_buffer[l_index] ) * uc_panel.large_scale;
+  }
+  strcpy( m_large_drawn, l_buffer );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * binary_enter - prepares the binary face.
+ */
+
+static void faces_binary_enter( void )
+{
+  faces_create_pens();
+  memset( m_binary_drawn, -1, sizeof( m_binary_drawn ) );
+  return;
+}
+
+
+/*
+ * binary_render - each digit of the time is shown as a column of four bits,
+ *                 most significant at the top.
+ */
+
+static void faces_binary_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  int8_t        l_digits[6];
+  uint_fast8_t  l_index, l_bit;
+  int32_t       l_x;
+
+  /* Split the time up into digits. */
+  l_digits[0] = p_time->hour / 10;
+  l_digits[1] = p_time->hour % 10;
+  l_digits[2] = p_time->min / 10;
+  l_digits[3] = p_time->min % 10;
+  l_digits[4] = p_time->sec / 10;
+  l_digits[5] = p_time->sec % 10;
+
+  /* And draw any that have changed; pairs of digits are spaced apart. */
+  l_x = uc_panel.binary_x;
+  for ( l_index = 0; l_index < 6; l_index++ )
+  {
+    if ( l_digits[l_index] != m_binary_drawn[l_index] )
+    {
+      for ( l_bit = 0; l_bit < 4; l_bit++ )
+      {
+        display_fill_rect( ( l_digits[l_index] & ( 1 << l_bit ) ) ? m_face_white_pen : m_face_dim_pen,
+                           l_x, uc_panel.binary_y + ( 3 - l_bit ) * uc_panel.binary_pitch, 
+                           uc_panel.binary_width, uc_panel.binary_pitch - 1 );
+      }
+      m_binary_drawn[l_index] = l_digits[l_index];
+    }
+    l_x += ( l_index & 1 ) ? uc_panel.binary_digit_step : uc_panel.binary_pair_step;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * progress_enter - prepares the day progress face.
+ */
+
+static void faces_progress_enter( void )
+{
+  faces_create_pens();
+  m_progress_drawn = -1;
+  return;
+}
+
+
+/*
+ * progress_render - shows how far through the day we are, as a bar filling
+ *                   up from midnight to midnight.
+ */
+
+static void faces_progress_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  uint32_t      l_seconds;
+  int           l_filled;
+  uint_fast8_t  l_hour;
+  int32_t       l_x, l_y, l_width;
+
+  /* The bar goes wherever the panel layout says. */
+  l_x = uc_panel.progress_x;
+  l_y = uc_panel.progress_y;
+  l_width = uc_panel.progress_width;
+
+  /* Draw the outline and hour markers, the first time round. */
+  if ( m_progress_drawn < 0 )
+  {
+    display_fill_rect( m_face_dim_pen, l_x, l_y, l_width, 1 );
+    display_fill_rect( m_face_dim_pen, l_x, l_y + 6, l_width, 1 );
+    display_fill_rect( m_face_dim_pen, l_x, l_y, 1, 7 );
+    display_fill_rect( m_face_dim_pen, l_x + l_width - 1, l_y, 1, 7 );
+    for ( l_hour = 0; l_hour <= 24; l_hour += 6 )
+    {
+      display_draw_pixel( m_face_dim_pen, l_x + 1 + ( l_hour * ( l_width - 3 ) ) / 24, l_y + 8 );
+    }
+  }
+
+  /* Work out how much of the inside should be filled. */
+  l_seconds = ( ( ( p_time->hour * 60 ) + p_time->min ) * 60 ) + p_time->sec;
+  l_filled = ( l_seconds * ( l_width - 2 ) ) / 86400;
+
+  /* And only redraw it when that changes. */
+  if ( l_filled != m_progress_drawn )
+  {
+    display_fill_rect( m_face_fill_pen, l_x + 1, l_y + 1, l_filled, 5 );
+    display_fill_rect( m_face_black_pen, l_x + 1 + l_filled, l_y + 1, l_width - 2 - l_filled, 5 );
+    m_progress_drawn = l_filled;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * seconds_enter - prepares the seconds face.
+ */
+
+static void faces_seconds_enter( void )
+{
+  faces_create_pens();
+  format_compile( "S", ':', nullptr, &m_seconds_program );
+  m_seconds_drawn = m_sweep_drawn = -1;
+  return;
+}
+
+
+/*
+ * seconds_render - just the seconds, nice and big, with a line sweeping along
+ *                  the bottom through each second.
+ */
+
+static void faces_seconds_render( const uc_config_t *p_config, const datetime_t *p_time )
+{
+  char    l_buffer[4];
+  int     l_sweep;
+
+  /* Redraw the digits when the second changes. */
+  if ( p_time->sec != m_seconds_drawn )
+  {
+    format_render( &m_seconds_program, p_time, l_buffer, 3, nullptr );
+    display_blit_scaled_glyph( l_buffer[0], uc_panel.seconds_x, uc_panel.seconds_y, uc_panel.seconds_scale, 
+                               uc_panel.seconds_height, m_face_white_pen, m_face_black_pen );
+    display_blit_scaled_glyph( l_buffer[1], 
+                               uc_panel.seconds_x + display_glyph_width( l_buffer[0] ) * uc_panel.seconds_scale, 
+                               uc_panel.seconds_y, uc_panel.seconds_scale, uc_panel.seconds_height, 
+                               m_face_white_pen, m_face_black_pen );
+    m_seconds_drawn = p_time->sec;
+  }
+
+  /* The sweep starts again at the start of each second. */
+  l_sweep = ( time_subsecond_us() * ( UC_PANEL_WIDTH - 1 ) ) / 1000000;
+  if ( l_sweep < m_sweep_drawn )
+  {
+    display_fill_rect( m_face_black_pen, 0, uc_panel.sweep_y, UC_PANEL_WIDTH - 1, 1 );
+    m_sweep_drawn = 0;
+  }
+  if ( l_sweep > m_sweep_drawn )
+  {
+    if ( m_sweep_drawn < 0 )
+    {
+      m_sweep_drawn = 0;
+    }
+    display_fill_rect( m_face_dim_pen, m_sweep_drawn, uc_panel.sweep_y, l_sweep - m_sweep_drawn, 1 );
+    m_sweep_drawn = l_sweep;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* Functions.*/
+
+/* The faces themselves, for the display code to choose between. */
+
+const uc_face_t uc_face_large = 
+  { "large", 0, faces_large_enter, faces_large_render, nullptr, nullptr };
+const uc_face_t uc_face_binary = 
+  { "binary", 0, faces_binary_enter, faces_binary_render, nullptr, nullptr };
+const uc_face_t uc_face_progress = 
+  { "progress", 0, faces_progress_enter, faces_progress_render, nullptr, nullptr };
+const uc_face_t uc_face_seconds = 
+  { "seconds", UC_SECONDS_FRAME_MS, faces_seconds_enter, faces_seconds_render, nullptr, nullptr };
+
+
+/* End of file faces.cpp */
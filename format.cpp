@@ -0,0 +1,463 @@
+/*
+ * format.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Date and time formatting; the format strings from the configuration file
+ * are compiled once, when it's read, into a short list of steps. Rendering 
+ * then just walks those steps, writing digits and names straight into the
+ * caller's buffer, rather than going through snprintf every frame.
+ *
+ * Format strings use single letters for fields - d(ay), m(onth), y(ear),
+ * b (month name), a (weekday name), H (24 hour), I (12 hour), M(inute), 
+ * S(econd) and p (AM/PM) - and anything else is copied as it is. A format
+ * made only of fields, like the original "dmy", gets a default separator
+ * between each pair of numbers, and a space either side of any names.
+ *
+ * Text is UTF-8, but the font only goes a little beyond the basic character
+ * set - Æ Þ ß æ þ £ ¥ © and ° - so that's all that can be drawn; names are
+ * available in a handful of languages, limited to those which fit in that.
+ * Text is turned into the atlas' own single byte characters as it's put
+ * into the caller's buffer.
+ * 
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+
+
+/* Module variables. */
+
+typedef struct
+{
+  const char   *code;
+  const char   *month_names[12];
+  const char   *weekday_names[7];
+} uc_language_t;
+
+static constexpr uc_language_t m_languages[] = 
+{
+  { "en", { "Jan", "Feb", "Mar", "Apr", "May", "Jun", 
+            "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" },
+          { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" } },
+  { "de", { "Jan", "Feb", "Mrz", "Apr", "Mai", "Jun", 
+            "Jul", "Aug", "Sep", "Okt", "Nov", "Dez" },
+          { "So", "Mo", "Di", "Mi", "Do", "Fr", "Sa" } },
+  { "nl", { "jan", "feb", "mrt", "apr", "mei", "jun", 
+            "jul", "aug", "sep", "okt", "nov", "dec" },
+          { "zo", "ma", "di", "wo", "do", "vr", "za" } },
+  { "it", { "gen", "feb", "mar", "apr", "mag", "giu", 
+            "lug", "ago", "set", "ott", "nov", "dic" },
+          { "dom", "lun", "mar", "mer", "gio", "ven", "sab" } },
+};
+
+#define UC_LANGUAGES  ( sizeof( m_languages ) / sizeof( m_languages[0] ) )
+
+/* The code points of the font's extra glyphs, in the order they're in the atlas. */
+static constexpr uint16_t m_extra_glyphs[] = 
+{
+  0x00c6, 0x00de, 0x00df, 0x00e6, 0x00fe, 0x00a3, 0x00a5, 0x00a9, 0x00b0
+};
+
+#define UC_EXTRA_GLYPHS  ( sizeof( m_extra_glyphs ) / sizeof( m_extra_glyphs[0] ) )
+
+static_assert( UC_ATLAS_GLYPHS == 96 + UC_EXTRA_GLYPHS,
+               "The atlas must hold the basic character set, and every extra glyph" );
+
+
+/* Conversion. */
+
+/*
+ * next_glyph - reads the next UTF-8 character from a string, moving it on,
+ *              and returns the atlas character for it; anything the font
+ *              doesn't have comes back as UC_GLYPH_NONE, which isn't drawn.
+ */
+
+static constexpr char format_next_glyph( const char **p_text )
+{
+  uint8_t       l_lead = 0, l_next = 0;
+  uint_fast16_t l_code = 0;
+  uint_fast8_t  l_index = 0;
+
+  /* The basic character set is just itself. */
+  l_lead = (uint8_t)*( *p_text )++;
+  if ( l_lead < 0x80 )
+  {
+    return (char)l_lead;
+  }
+
+  /* The extras are all two byte sequences, so look for those. */
+  l_next = (uint8_t)**p_text;
+  if ( ( ( l_lead & 0xe0 ) == 0xc0 ) && ( ( l_next & 0xc0 ) == 0x80 ) )
+  {
+    ( *p_text )++;
+    l_code = ( ( l_lead & 0x1f ) << 6 ) | ( l_next & 0x3f );
+    for ( l_index = 0; l_index < UC_EXTRA_GLYPHS; l_index++ )
+    {
+      if ( m_extra_glyphs[l_index] == l_code )
+      {
+        return (char)( ' ' + 96 + l_index );
+      }
+    }
+    return UC_GLYPH_NONE;
+  }
+
+  /* Anything else is skipped over, continuation bytes and all. */
+  while ( ( (uint8_t)**p_text & 0xc0 ) == 0x80 )
+  {
+    ( *p_text )++;
+  }
+  return UC_GLYPH_NONE;
+}
+
+
+/* Build time checks. */
+
+/*
+ * glyphs_present - confirms that every character in a string has a glyph in
+ *                  the display's atlas; anything accented, beyond the font's
+ *                  few extras, will fail.
+ */
+
+static constexpr bool format_glyphs_present( const char *p_text )
+{
+  uint8_t   l_glyph = 0;
+
+  while ( *p_text != '\0' )
+  {
+    l_glyph = (uint8_t)format_next_glyph( &p_text );
+    if ( ( l_glyph < ' ' ) || ( l_glyph >= ' ' + UC_ATLAS_GLYPHS ) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/*
+ * languages_drawable - confirms that every name, in every language, can be
+ *                      drawn; checked when we're built, not when we run.
+ */
+
+static constexpr bool format_languages_drawable( void )
+{
+  for ( const uc_language_t &l_language : m_languages )
+  {
+    for ( const char *l_name : l_language.month_names )
+    {
+      if ( !format_glyphs_present( l_name ) )
+      {
+        return false;
+      }
+    }
+    for ( const char *l_name : l_language.weekday_names )
+    {
+      if ( !format_glyphs_present( l_name ) )
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert( format_languages_drawable(), 
+               "Month and weekday names must only use glyphs in the font atlas" );
+
+
+/* Local functions. */
+
+/*
+ * field_op - returns the opcode for a format letter, or UC_FORMAT_LITERAL if
+ *            it isn't one we know about.
+ */
+
+static uc_format_op_t format_field_op( char p_letter )
+{
+  switch( p_letter )
+  {
+    case 'd': return UC_FORMAT_DAY;
+    case 'm': return UC_FORMAT_MONTH;
+    case 'y': return UC_FORMAT_YEAR;
+    case 'b': return UC_FORMAT_MONTH_NAME;
+    case 'a': return UC_FORMAT_WEEKDAY_NAME;
+    case 'H': return UC_FORMAT_HOUR24;
+    case 'I': return UC_FORMAT_HOUR12;
+    case 'M': return UC_FORMAT_MINUTE;
+    case 'S': return UC_FORMAT_SECOND;
+    case 'p': return UC_FORMAT_AMPM;
+  }
+  return UC_FORMAT_LITERAL;
+}
+
+
+/*
+ * field_numeric - returns true if a field is drawn as a number, rather than
+ *                 as a name.
+ */
+
+static bool format_field_numeric( uc_format_op_t p_op )
+{
+  return ( p_op != UC_FORMAT_LITERAL ) && ( p_op != UC_FORMAT_MONTH_NAME ) &&
+         ( p_op != UC_FORMAT_WEEKDAY_NAME ) && ( p_op != UC_FORMAT_AMPM );
+}
+
+
+/*
+ * put_digits - writes a number as a fixed number of digits, with leading
+ *              zeros, returning the new write position. The width of the
+ *              digits drawn is added to the running total.
+ */
+
+static uint_fast8_t format_put_digits( char *p_buffer, uint_fast8_t p_pos, 
+                                       uint_fast8_t p_maxlen, uint_fast16_t p_value, 
+                                       uint_fast8_t p_width, uint_fast16_t *p_pixels )
+{
+  uint_fast8_t  l_index;
+
+  /* Make sure there's room for it all, or don't bother. */
+  if ( p_pos + p_width > p_maxlen )
+  {
+    return p_pos;
+  }
+
+  /* Fill in from the right hand end. */
+  for ( l_index = p_width; l_index > 0; l_index-- )
+  {
+    p_buffer[p_pos + l_index - 1] = '0' + ( p_value % 10 );
+    *p_pixels += display_glyph_width( '0' + ( p_value % 10 ) );
+    p_value /= 10;
+  }
+
+  /* All done. */
+  return p_pos + p_width;
+}
+
+
+/*
+ * text_width - works out how wide a string will be when drawn, from the widths
+ *              of the glyphs in the atlas.
+ */
+
+static uint_fast8_t format_text_width( const char *p_text )
+{
+  uint_fast8_t  l_width = 0;
+
+  while ( *p_text != '\0' )
+  {
+    l_width += display_glyph_width( format_next_glyph( &p_text ) );
+  }
+  return l_width;
+}
+
+
+/*
+ * put_text - copies a name into the buffer, as atlas characters, returning the
+ *            new write position.
+ */
+
+static uint_fast8_t format_put_text( char *p_buffer, uint_fast8_t p_pos, 
+                                     uint_fast8_t p_maxlen, const char *p_text )
+{
+  while ( ( *p_text != '\0' ) && ( p_pos < p_maxlen ) )
+  {
+    p_buffer[p_pos++] = format_next_glyph( &p_text );
+  }
+  return p_pos;
+}
+
+
+/* Functions.*/
+
+/*
+ * compile - turns a format string into a list of steps; if the format only 
+ *           contains fields, the separator is placed between each pair of
+ *           numbers, and names are spaced off from whatever is next to them.
+ *           Names are taken from the requested language (falling back to
+ *           English), and the width of anything fixed is worked out now.
+ */
+
+void format_compile( const char *p_format, char p_separator, const char *p_language,
+                     uc_format_t *p_program )
+{
+  const uc_language_t  *l_language;
+  const char           *l_char;
+  bool                  l_fields_only;
+  uint_fast8_t          l_count, l_index;
+  uc_format_op_t        l_op, l_last_op;
+  char                  l_separator;
+
+  /* Find the language we want the names in, and measure them. */
+  l_language = &m_languages[0];
+  for ( l_index = 0; l_index < UC_LANGUAGES; l_index++ )
+  {
+    if ( ( p_language != nullptr ) && ( strcmp( m_languages[l_index].code, p_language ) == 0 ) )
+    {
+      l_language = &m_languages[l_index];
+      break;
+    }
+  }
+  p_program->month_names = l_language->month_names;
+  p_program->weekday_names = l_language->weekday_names;
+  for ( l_index = 0; l_index < 12; l_index++ )
+  {
+    p_program->month_widths[l_index] = format_text_width( l_language->month_names[l_index] );
+  }
+  for ( l_index = 0; l_index < 7; l_index++ )
+  {
+    p_program->weekday_widths[l_index] = format_text_width( l_language->weekday_names[l_index] );
+  }
+
+  /* First off, see if there are any separators of the user's own. */
+  l_fields_only = true;
+  for ( l_char = p_format; *l_char != '\0'; l_char++ )
+  {
+    if ( format_field_op( *l_char ) == UC_FORMAT_LITERAL )
+    {
+      l_fields_only = false;
+      break;
+    }
+  }
+
+  /* Now work through the string, a step at a time. */
+  l_count = 0;
+  l_last_op = UC_FORMAT_END;
+  for ( l_char = p_format; ( *l_char != '\0' ) && ( l_count < UC_FORMAT_MAXSTEPS - 2 ); l_char++ )
+  {
+    /*
+     * Fields-only formats get the separator between two numbers; a name, such
+     * as AM / PM, is just spaced off, as "12:30:PM" would make no sense.
+     */
+    l_op = format_field_op( *l_char );
+    if ( l_fields_only && ( l_count > 0 ) )
+    {
+      l_separator = ( format_field_numeric( l_last_op ) && format_field_numeric( l_op ) ) ? p_separator : ' ';
+      p_program->steps[l_count].op = UC_FORMAT_LITERAL;
+      p_program->steps[l_count].value = l_separator;
+      p_program->steps[l_count].width = display_glyph_width( l_separator );
+      l_count++;
+    }
+    l_last_op = l_op;
+
+    /* Work out what the step is, and how wide any number should be. */
+    p_program->steps[l_count].op = l_op;
+    switch( l_op )
+    {
+      case UC_FORMAT_LITERAL:
+        /* Literals may be UTF-8, so take the whole character. */
+        p_program->steps[l_count].value = format_next_glyph( &l_char );
+        p_program->steps[l_count].width = display_glyph_width( p_program->steps[l_count].value );
+        l_char--;
+        break;
+      case UC_FORMAT_YEAR:
+        p_program->steps[l_count].value = 4;
+        break;
+      default:
+        p_program->steps[l_count].value = 2;
+        break;
+    }
+    l_count++;
+  }
+
+  /* And mark the end of the program. */
+  p_program->steps[l_count].op = UC_FORMAT_END;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render - runs a compiled format against a date and time, writing the text
+ *          into the buffer provided (which must have room for the terminator
+ *          as well). Returns the length of the text and, if asked, how wide
+ *          it will be on the display.
+ */
+
+uint_fast8_t format_render( const uc_format_t *p_program, const datetime_t *p_time, 
+                            char *p_buffer, uint_fast8_t p_maxlen, uint_fast16_t *p_width )
+{
+  const uc_format_step_t *l_step;
+  const char             *l_ampm;
+  uint_fast8_t            l_pos, l_name;
+  uint_fast16_t           l_width;
+
+  /* Just run through each step, until we hit the end (or run out of room). */
+  l_pos = 0;
+  l_width = 0;
+  for ( l_step = p_program->steps; ( l_step->op != UC_FORMAT_END ) && ( l_pos < p_maxlen ); l_step++ )
+  {
+    switch( l_step->op )
+    {
+      case UC_FORMAT_LITERAL:
+        p_buffer[l_pos++] = l_step->value;
+        l_width += l_step->width;
+        break;
+      case UC_FORMAT_DAY:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, p_time->day, l_step->value, &l_width );
+        break;
+      case UC_FORMAT_MONTH:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, p_time->month, l_step->value, &l_width );
+        break;
+      case UC_FORMAT_YEAR:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, p_time->year, l_step->value, &l_width );
+        break;
+      case UC_FORMAT_MONTH_NAME:
+        l_name = ( p_time->month + 11 ) % 12;
+        l_pos = format_put_text( p_buffer, l_pos, p_maxlen, p_program->month_names[l_name] );
+        l_width += p_program->month_widths[l_name];
+        break;
+      case UC_FORMAT_WEEKDAY_NAME:
+        l_name = p_time->dotw % 7;
+        l_pos = format_put_text( p_buffer, l_pos, p_maxlen, p_program->weekday_names[l_name] );
+        l_width += p_program->weekday_widths[l_name];
+        break;
+      case UC_FORMAT_HOUR24:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, p_time->hour, l_step->value, &l_width );
+        break;
+      case UC_FORMAT_HOUR12:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, ( ( p_time->hour + 11 ) % 12 ) + 1, 
+                                   l_step->value, &l_width );
+        break;
+      case UC_FORMAT_MINUTE:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, p_time->min, l_step->value, &l_width );
+        break;
+      case UC_FORMAT_SECOND:
+        l_pos = format_put_digits( p_buffer, l_pos, p_maxlen, p_time->sec, l_step->value, &l_width );
+        break;
+      case UC_FORMAT_AMPM:
+        /* Short enough to just measure as we go. */
+        l_ampm = ( p_time->hour < 12 ) ? "AM" : "PM";
+        l_pos = format_put_text( p_buffer, l_pos, p_maxlen, l_ampm );
+        l_width += format_text_width( l_ampm );
+        break;
+      default:
+        break;
+    }
+  }
+
+  /* Terminate it, and we're done. */
+  p_buffer[l_pos] = '\0';
+  if ( p_width != nullptr )
+  {
+    *p_width = l_width;
+  }
+  return l_pos;
+}
+
+
+/* End of file format.cpp */
@@ -0,0 +1,205 @@
+/*
+ * host.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Stand-ins for the parts of UniClock (and the SDK) that the rendering code
+ * leans on, for the host build. The RTC is a fixed time that the host sets,
+ * the filesystem is always empty, and anything sent to the debug channel is
+ * either printed (messages) or kept for the host to pick up (binary data).
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pico/stdlib.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+#include "usbfs.hpp"
+#include "host.h"
+
+
+/* Module variables. */
+
+static datetime_t   m_rtc = { 2023, 6, 21, 3, 12, 0, 0 };
+static datetime_t   m_override_time;
+static bool         m_override_active;
+static int16_t      m_utc_offset;
+static uint8_t     *m_debug_data;
+static size_t       m_debug_length, m_debug_size;
+
+
+/* Functions.*/
+
+/*
+ * time_us_64 - the time since we started, as the Pico would count it since
+ *              boot; this is the real time, so that timings mean something.
+ */
+
+uint64_t time_us_64( void )
+{
+  static struct timespec  l_start;
+  struct timespec         l_now;
+
+  /* The first call marks the start. */
+  if ( l_start.tv_sec == 0 )
+  {
+    clock_gettime( CLOCK_MONOTONIC, &l_start );
+  }
+  clock_gettime( CLOCK_MONOTONIC, &l_now );
+  return 1 + ( ( l_now.tv_sec - l_start.tv_sec ) * 1000000ULL ) + 
+         ( ( l_now.tv_nsec - l_start.tv_nsec ) / 1000 );
+}
+
+
+/*
+ * The fake RTC; the host sets the time, and it stays there.
+ */
+
+void host_set_datetime( const datetime_t *p_datetime )
+{
+  m_rtc = *p_datetime;
+  return;
+}
+
+void host_set_utc_offset( int16_t p_offset )
+{
+  m_utc_offset = p_offset;
+  return;
+}
+
+void time_get_datetime( datetime_t *p_datetime )
+{
+  *p_datetime = m_override_active ? m_override_time : m_rtc;
+  return;
+}
+
+void time_override( const datetime_t *p_datetime )
+{
+  m_override_active = ( p_datetime != nullptr );
+  if ( m_override_active )
+  {
+    m_override_time = *p_datetime;
+  }
+  return;
+}
+
+int16_t time_get_utc_offset( void )
+{
+  return m_utc_offset;
+}
+
+uint32_t time_subsecond_us( void )
+{
+  return 0;
+}
+
+
+/*
+ * The debug channel; messages go to stdout, and anything binary is kept. The
+ * device cuts messages short at USB_DEBUG_MAXLEN, so any that wouldn't fit
+ * are caught here rather than quietly losing their ends.
+ */
+
+void usb_debug( const char *p_message, ... )
+{
+  va_list l_args;
+  char    l_buffer[256];
+  int     l_msglen;
+
+  va_start( l_args, p_message );
+  l_msglen = vsnprintf( l_buffer, sizeof( l_buffer ), p_message, l_args );
+  va_end( l_args );
+  puts( l_buffer );
+  assert( l_msglen < USB_DEBUG_MAXLEN );
+  return;
+}
+
+void usb_debug_write( const void *p_data, uint32_t p_length )
+{
+  /* Make sure there's room, and tack it on the end. */
+  if ( m_debug_length + p_length > m_debug_size )
+  {
+    m_debug_size = ( m_debug_length + p_length ) * 2;
+    m_debug_data = (uint8_t *)realloc( m_debug_data, m_debug_size );
+  }
+  memcpy( m_debug_data + m_debug_length, p_data, p_length );
+  m_debug_length += p_length;
+  return;
+}
+
+const uint8_t *host_debug_output( size_t *p_length )
+{
+  *p_length = m_debug_length;
+  return m_debug_data;
+}
+
+void host_debug_clear( void )
+{
+  m_debug_length = 0;
+  return;
+}
+
+
+/*
+ * The filesystem, and configuration; there's nothing saved on the host, and
+ * nothing we save is kept.
+ */
+
+FRESULT ufs_mount( void )
+{
+  return FR_OK;
+}
+
+FRESULT ufs_unmount( void )
+{
+  return FR_OK;
+}
+
+void usb_fs_changed( void )
+{
+  return;
+}
+
+FRESULT f_open( FIL *p_fptr, const TCHAR *p_path, BYTE p_mode )
+{
+  return FR_NO_FILE;
+}
+
+FRESULT f_read( FIL *p_fptr, void *p_buffer, UINT p_length, UINT *p_read )
+{
+  *p_read = 0;
+  return FR_INVALID_OBJECT;
+}
+
+FRESULT f_write( FIL *p_fptr, const void *p_buffer, UINT p_length, UINT *p_written )
+{
+  *p_written = 0;
+  return FR_INVALID_OBJECT;
+}
+
+FRESULT f_close( FIL *p_fptr )
+{
+  return FR_OK;
+}
+
+bool config_write( const uc_config_t *p_config )
+{
+  return true;
+}
+
+
+/* End of file host.cpp */
@@ -0,0 +1,26 @@
+/*
+ * host.h - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * The host build's side of things; the fake RTC, and access to whatever the
+ * rendering code sent out over the debug channel.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+void            host_set_datetime( const datetime_t * );
+void            host_set_utc_offset( int16_t );
+const uint8_t  *host_debug_output( size_t * );
+void            host_debug_clear( void );
+
+/* End of file host.h */
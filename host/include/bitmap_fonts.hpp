@@ -0,0 +1,32 @@
+/*
+ * bitmap_fonts.hpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for Pimoroni's bitmap font definitions, for the host build.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace bitmap 
+{
+  const int base_chars = 96;
+  const int extra_chars = 9;
+  const int accent_chars = 8;
+
+  struct font_t 
+  {
+    const uint8_t height;
+    const uint8_t max_width;
+    const uint8_t widths[base_chars + extra_chars];
+    const uint8_t data[];
+  };
+}
+
+/* End of file bitmap_fonts.hpp */
@@ -0,0 +1,107 @@
+/*
+ * host_unicorn.hpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for the Unicorn drivers, for the host build. Rather than clock
+ * pixels out to LEDs, it keeps hold of the value the driver would put in its
+ * bitstream for each one; the colour scaled by the brightness, and then gamma
+ * corrected into 14 bits, just as Pimoroni's set_pixel() does. Both ways in -
+ * update() with the whole framebuffer, and set_pixel() - convert pens exactly
+ * as the real driver does, so the two can be compared.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "libraries/pico_graphics/pico_graphics.hpp"
+
+namespace pimoroni 
+{
+  template <int t_width, int t_height> class HostUnicorn 
+  {
+  public:
+    static const int WIDTH = t_width;
+    static const int HEIGHT = t_height;
+
+    static const uint8_t SWITCH_A = 0, SWITCH_B = 1, SWITCH_C = 3, SWITCH_D = 6;
+    static const uint8_t SWITCH_SLEEP = 27, SWITCH_VOLUME_UP = 7, SWITCH_VOLUME_DOWN = 8;
+    static const uint8_t SWITCH_BRIGHTNESS_UP = 21, SWITCH_BRIGHTNESS_DOWN = 26;
+
+    static const int BCD_FRAME_COUNT = 14;
+
+    uint16_t  pixels[t_width * t_height][3];
+    uint32_t  pixels_set;
+    uint16_t  brightness;
+    uint16_t  gamma_lut[256];
+
+    HostUnicorn() : pixels_set( 0 ), brightness( 256 ) 
+    {
+      memset( pixels, 0, sizeof( pixels ) );
+      for ( int l_value = 0; l_value < 256; l_value++ )
+      {
+        gamma_lut[l_value] = (uint16_t)( powf( (float)l_value / 255.0f, 1.8f ) * 
+                                         ( float( 1U << BCD_FRAME_COUNT ) - 1.0f ) + 0.5f );
+      }
+    }
+
+    void init( void ) {}
+
+    void set_brightness( float p_value ) 
+    { 
+      p_value = p_value < 0.0f ? 0.0f : p_value;
+      p_value = p_value > 1.0f ? 1.0f : p_value;
+      brightness = floor( p_value * 256.0f ); 
+    }
+
+    float get_brightness( void ) { return brightness / 255.0f; }
+
+    void set_pixel( int p_x, int p_y, uint8_t p_r, uint8_t p_g, uint8_t p_b ) 
+    {
+      if ( ( p_x < 0 ) || ( p_x >= t_width ) || ( p_y < 0 ) || ( p_y >= t_height ) )
+      {
+        return;
+      }
+      p_r = ( p_r * brightness ) >> 8;
+      p_g = ( p_g * brightness ) >> 8;
+      p_b = ( p_b * brightness ) >> 8;
+      pixels[( p_y * t_width ) + p_x][0] = gamma_lut[p_r];
+      pixels[( p_y * t_width ) + p_x][1] = gamma_lut[p_g];
+      pixels[( p_y * t_width ) + p_x][2] = gamma_lut[p_b];
+      pixels_set++;
+    }
+
+    void update( PicoGraphics *p_graphics ) 
+    {
+      uint16_t  l_pen;
+      int       l_x, l_y;
+
+      for ( l_y = 0; l_y < t_height; l_y++ )
+      {
+        for ( l_x = 0; l_x < t_width; l_x++ )
+        {
+          if ( p_graphics->pen_type == PicoGraphics::PEN_P8 )
+          {
+            const RGB &l_colour = dynamic_cast<PicoGraphics_PenP8 *>( p_graphics )->palette[( (uint8_t *)p_graphics->frame_buffer )[( l_y * t_width ) + l_x]];
+            set_pixel( l_x, l_y, l_colour.r, l_colour.g, l_colour.b );
+          }
+          else
+          {
+            l_pen = __builtin_bswap16( ( (uint16_t *)p_graphics->frame_buffer )[( l_y * t_width ) + l_x] );
+            set_pixel( l_x, l_y, ( l_pen & 0xf800 ) >> 8, ( l_pen & 0x07e0 ) >> 3, ( l_pen & 0x001f ) << 3 );
+          }
+        }
+      }
+    }
+  };
+}
+
+/* End of file host_unicorn.hpp */
@@ -0,0 +1,22 @@
+/*
+ * galactic_unicorn.hpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for Pimoroni's GalacticUnicorn driver, for the host build.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "host_unicorn.hpp"
+
+namespace pimoroni 
+{
+  typedef HostUnicorn<53, 11> GalacticUnicorn;
+}
+
+/* End of file galactic_unicorn.hpp */
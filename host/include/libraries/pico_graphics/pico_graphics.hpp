@@ -0,0 +1,175 @@
+/*
+ * pico_graphics.hpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for Pimoroni's PicoGraphics, for the host build. The rendering
+ * code writes straight into the framebuffer, so all that's needed here is
+ * the framebuffer itself and the pens; these behave as PicoGraphics does,
+ * with RGB565 pens held byte-swapped and P8 pens as palette entries. The
+ * self test also times PicoGraphics' own pixel drawing, which goes through
+ * the same virtual pen and clip calls as the real thing.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "bitmap_fonts.hpp"
+
+namespace pimoroni 
+{
+  typedef uint16_t RGB565;
+
+  struct RGB 
+  {
+    int16_t r, g, b;
+
+    constexpr RGB() : r( 0 ), g( 0 ), b( 0 ) {}
+    constexpr RGB( uint8_t p_r, uint8_t p_g, uint8_t p_b ) : r( p_r ), g( p_g ), b( p_b ) {}
+
+    constexpr RGB565 to_rgb565() 
+    {
+      return __builtin_bswap16( ( ( r & 0b11111000 ) << 8 ) | ( ( g & 0b11111100 ) << 3 ) | ( ( b & 0b11111000 ) >> 3 ) );
+    }
+  };
+
+  struct Point 
+  {
+    int32_t x, y;
+
+    Point( int32_t p_x, int32_t p_y ) : x( p_x ), y( p_y ) {}
+  };
+
+  struct Rect 
+  {
+    int32_t x, y, w, h;
+
+    Rect( int32_t p_x, int32_t p_y, int32_t p_w, int32_t p_h ) : x( p_x ), y( p_y ), w( p_w ), h( p_h ) {}
+    bool contains( const Point &p_point ) const
+    {
+      return ( p_point.x >= x ) && ( p_point.y >= y ) && ( p_point.x < x + w ) && ( p_point.y < y + h );
+    }
+  };
+
+  class PicoGraphics 
+  {
+  public:
+    enum PenType { PEN_P8, PEN_RGB565 };
+
+    void                   *frame_buffer;
+    PenType                 pen_type;
+    Rect                    bounds, clip;
+    const bitmap::font_t   *font;
+
+    PicoGraphics( uint16_t p_width, uint16_t p_height, void *p_frame_buffer ) 
+      : frame_buffer( p_frame_buffer ), bounds( 0, 0, p_width, p_height ), 
+        clip( 0, 0, p_width, p_height ), font( nullptr ) {}
+    virtual ~PicoGraphics() {}
+
+    void set_font( const bitmap::font_t *p_font ) { font = p_font; }
+    virtual void set_pen( uint p_pen ) = 0;
+    virtual int create_pen( uint8_t p_r, uint8_t p_g, uint8_t p_b ) = 0;
+    virtual int update_pen( uint8_t p_index, uint8_t p_r, uint8_t p_g, uint8_t p_b ) { return -1; }
+    virtual void set_pixel( const Point &p_point ) = 0;
+
+    void pixel( const Point &p_point )
+    {
+      if ( clip.contains( p_point ) )
+      {
+        set_pixel( p_point );
+      }
+    }
+  };
+
+  class PicoGraphics_PenRGB565 : public PicoGraphics 
+  {
+  public:
+    RGB565  color;
+
+    PicoGraphics_PenRGB565( uint16_t p_width, uint16_t p_height, void *p_frame_buffer ) 
+      : PicoGraphics( p_width, p_height, p_frame_buffer ) 
+    {
+      pen_type = PEN_RGB565;
+      if ( frame_buffer == nullptr )
+      {
+        frame_buffer = calloc( p_width * p_height, sizeof( RGB565 ) );
+      }
+    }
+
+    void set_pen( uint p_pen ) override 
+    { 
+      color = p_pen; 
+    }
+
+    int create_pen( uint8_t p_r, uint8_t p_g, uint8_t p_b ) override 
+    { 
+      return RGB( p_r, p_g, p_b ).to_rgb565(); 
+    }
+
+    void set_pixel( const Point &p_point ) override 
+    {
+      ( (RGB565 *)frame_buffer )[( p_point.y * bounds.w ) + p_point.x] = color;
+    }
+  };
+
+  class PicoGraphics_PenP8 : public PicoGraphics 
+  {
+  public:
+    static const uint16_t palette_size = 256;
+    RGB      palette[palette_size];
+    bool     used[palette_size];
+    uint8_t  color;
+
+    PicoGraphics_PenP8( uint16_t p_width, uint16_t p_height, void *p_frame_buffer ) 
+      : PicoGraphics( p_width, p_height, p_frame_buffer ) 
+    {
+      pen_type = PEN_P8;
+      if ( frame_buffer == nullptr )
+      {
+        frame_buffer = calloc( p_width * p_height, 1 );
+      }
+      memset( used, 0, sizeof( used ) );
+    }
+
+    void set_pen( uint p_pen ) override 
+    { 
+      color = p_pen; 
+    }
+
+    int create_pen( uint8_t p_r, uint8_t p_g, uint8_t p_b ) override 
+    {
+      for ( int l_index = 0; l_index < palette_size; l_index++ )
+      {
+        if ( !used[l_index] )
+        {
+          used[l_index] = true;
+          palette[l_index] = RGB( p_r, p_g, p_b );
+          return l_index;
+        }
+      }
+      return -1;
+    }
+
+    int update_pen( uint8_t p_index, uint8_t p_r, uint8_t p_g, uint8_t p_b ) override 
+    {
+      used[p_index] = true;
+      palette[p_index] = RGB( p_r, p_g, p_b );
+      return p_index;
+    }
+
+    void set_pixel( const Point &p_point ) override 
+    {
+      ( (uint8_t *)frame_buffer )[( p_point.y * bounds.w ) + p_point.x] = color;
+    }
+  };
+}
+
+/* End of file pico_graphics.hpp */
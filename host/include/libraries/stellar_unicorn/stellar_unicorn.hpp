@@ -0,0 +1,22 @@
+/*
+ * stellar_unicorn.hpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for Pimoroni's StellarUnicorn driver, for the host build.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "host_unicorn.hpp"
+
+namespace pimoroni 
+{
+  typedef HostUnicorn<16, 16> StellarUnicorn;
+}
+
+/* End of file stellar_unicorn.hpp */
@@ -0,0 +1,17 @@
+/*
+ * lwip/dns.h - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for lwIP, for the host build; see lwip/udp.h.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include "lwip/udp.h"
+
+/* End of file lwip/dns.h */
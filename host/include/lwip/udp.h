@@ -0,0 +1,26 @@
+/*
+ * lwip/udp.h - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for lwIP, for the host build; the rendering code never touches
+ * the network, so only the types that uniclock.h mentions are needed.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef struct
+{
+  uint32_t  addr;
+} ip_addr_t;
+
+struct udp_pcb;
+struct pbuf;
+
+/* End of file lwip/udp.h */
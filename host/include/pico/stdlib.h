@@ -0,0 +1,52 @@
+/*
+ * pico/stdlib.h - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * A stand-in for the Pico SDK's standard header, for the host build; just the
+ * types and calls that the rendering code uses. Time is microseconds since
+ * the host program started, as it is since boot on the Pico.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef unsigned int uint;
+
+typedef uint64_t absolute_time_t;
+static const absolute_time_t nil_time = 0;
+static const absolute_time_t at_the_end_of_time = UINT64_MAX;
+
+typedef struct
+{
+  int16_t year;
+  int8_t  month, day, dotw, hour, min, sec;
+} datetime_t;
+
+uint64_t        time_us_64( void );
+
+static inline uint32_t time_us_32( void ) { return (uint32_t)time_us_64(); }
+static inline absolute_time_t get_absolute_time( void ) { return time_us_64(); }
+static inline absolute_time_t make_timeout_time_us( uint64_t p_us ) { return time_us_64() + p_us; }
+static inline absolute_time_t make_timeout_time_ms( uint32_t p_ms ) { return time_us_64() + p_ms * 1000ULL; }
+static inline absolute_time_t delayed_by_us( absolute_time_t p_time, uint64_t p_us ) { return p_time + p_us; }
+static inline absolute_time_t delayed_by_ms( absolute_time_t p_time, uint32_t p_ms ) { return p_time + p_ms * 1000ULL; }
+static inline bool time_reached( absolute_time_t p_time ) { return time_us_64() >= p_time; }
+static inline bool is_nil_time( absolute_time_t p_time ) { return p_time == nil_time; }
+static inline int64_t absolute_time_diff_us( absolute_time_t p_from, absolute_time_t p_to ) { return (int64_t)( p_to - p_from ); }
+static inline uint64_t to_us_since_boot( absolute_time_t p_time ) { return p_time; }
+static inline uint32_t to_ms_since_boot( absolute_time_t p_time ) { return p_time / 1000; }
+
+static inline void tight_loop_contents( void ) {}
+static inline void __wfe( void ) {}
+static inline void __sev( void ) {}
+static inline void __dmb( void ) { __sync_synchronize(); }
+
+/* End of file pico/stdlib.h */
@@ -0,0 +1,436 @@
+/*
+ * uniclock_host.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * The host renderer; this runs the same golden frame sweep that a debug build
+ * sends out over USB - every face, the date, the timezone and the brightness
+ * overlay, through a whole day - but on a Linux box. The frames can be saved
+ * as PPM images, and are checked against a list of known good frames; the
+ * timings for each scene are reported as they're rendered. Alternatively, it
+ * runs the same self test as a debug build does, or checks that pushing just
+ * the changes to the Unicorn leaves it just as a full update would.
+ *
+ *   uniclock_host [--self-test | --check-push] 
+ *                 [--frames <dir>] [--check <file> | --update <file>]
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+#include "host.h"
+
+
+/* Module variables. */
+
+typedef struct
+{
+  char            label[64];
+  const uint8_t  *pixels;
+  size_t          length;
+  uint32_t        hash;
+} uc_host_frame_t;
+
+#define UC_HOST_MAX_FRAMES    1024
+#define UC_HOST_PUSH_FRAMES   8
+
+static uc_host_frame_t  m_frames[UC_HOST_MAX_FRAMES];
+static uint_fast16_t    m_frame_count;
+
+
+/* Local functions. */
+
+/*
+ * hash - a simple FNV-1a hash of a frame's pixels, to tell frames apart.
+ */
+
+static uint32_t host_hash( const uint8_t *p_data, size_t p_length )
+{
+  uint32_t  l_hash = 2166136261UL;
+
+  while ( p_length-- > 0 )
+  {
+    l_hash = ( l_hash ^ *p_data++ ) * 16777619UL;
+  }
+  return l_hash;
+}
+
+
+/*
+ * split_frames - picks the individual PPM images out of what was sent to the
+ *                debug channel; each is labelled in its header comment.
+ */
+
+static bool host_split_frames( const uint8_t *p_data, size_t p_length )
+{
+  const char   *l_text;
+  size_t        l_offset = 0;
+  int           l_width, l_height, l_header;
+
+  m_frame_count = 0;
+  while ( l_offset < p_length )
+  {
+    /* Each one starts with a simple header. */
+    l_text = (const char *)p_data + l_offset;
+    if ( ( m_frame_count >= UC_HOST_MAX_FRAMES ) ||
+         ( sscanf( l_text, "P6\n# %63[^\n]\n%d %d\n255\n%n", m_frames[m_frame_count].label,
+                   &l_width, &l_height, &l_header ) != 3 ) )
+    {
+      fprintf( stderr, "Unexpected data in the frame stream at %zu\n", l_offset );
+      return false;
+    }
+
+    /* And is followed by the pixels. */
+    m_frames[m_frame_count].pixels = p_data + l_offset + l_header;
+    m_frames[m_frame_count].length = l_width * l_height * 3;
+    m_frames[m_frame_count].hash = host_hash( m_frames[m_frame_count].pixels,
+                                              m_frames[m_frame_count].length );
+    l_offset += l_header + m_frames[m_frame_count].length;
+    m_frame_count++;
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * save_frames - writes each frame out as a PPM image of its own.
+ */
+
+static bool host_save_frames( const char *p_directory )
+{
+  char            l_filename[256];
+  FILE           *l_fptr;
+  uint_fast16_t   l_index;
+
+  for ( l_index = 0; l_index < m_frame_count; l_index++ )
+  {
+    snprintf( l_filename, sizeof( l_filename ), "%s/frame%03u.ppm", p_directory, (unsigned)l_index );
+    l_fptr = fopen( l_filename, "wb" );
+    if ( l_fptr == nullptr )
+    {
+      fprintf( stderr, "Unable to write %s\n", l_filename );
+      return false;
+    }
+    fprintf( l_fptr, "P6\n# %s\n%d %d\n255\n", m_frames[l_index].label,
+             UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+    fwrite( m_frames[l_index].pixels, 1, m_frames[l_index].length, l_fptr );
+    fclose( l_fptr );
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * check_frames - compares the frames against a list of known good ones, as
+ *                written by update_frames. Returns the number that differ.
+ */
+
+static int host_check_frames( const char *p_filename )
+{
+  char            l_line[128], l_label[64];
+  FILE           *l_fptr;
+  uint_fast16_t   l_index = 0;
+  unsigned long   l_hash;
+  int             l_failures = 0;
+
+  l_fptr = fopen( p_filename, "r" );
+  if ( l_fptr == nullptr )
+  {
+    fprintf( stderr, "Unable to read %s\n", p_filename );
+    return -1;
+  }
+
+  /* Each line is the hash, followed by the label. */
+  while ( fgets( l_line, sizeof( l_line ), l_fptr ) != nullptr )
+  {
+    if ( sscanf( l_line, "%lx %63[^\n]", &l_hash, l_label ) != 2 )
+    {
+      continue;
+    }
+    if ( l_index >= m_frame_count )
+    {
+      fprintf( stderr, "Missing frame: %s\n", l_label );
+      l_failures++;
+    }
+    else if ( ( strcmp( l_label, m_frames[l_index].label ) != 0 ) || ( l_hash != m_frames[l_index].hash ) )
+    {
+      fprintf( stderr, "Frame %u differs: expected %s (%08lx), got %s (%08x)\n", (unsigned)l_index,
+               l_label, l_hash, m_frames[l_index].label, m_frames[l_index].hash );
+      l_failures++;
+    }
+    l_index++;
+  }
+  fclose( l_fptr );
+
+  /* Any left over are new, which is just as wrong. */
+  if ( l_index < m_frame_count )
+  {
+    fprintf( stderr, "%u unexpected frames\n", (unsigned)( m_frame_count - l_index ) );
+    l_failures += m_frame_count - l_index;
+  }
+
+  /* All done. */
+  return l_failures;
+}
+
+
+/*
+ * update_frames - writes out the list of frames, as the new known good ones.
+ */
+
+static bool host_update_frames( const char *p_filename )
+{
+  FILE           *l_fptr;
+  uint_fast16_t   l_index;
+
+  l_fptr = fopen( p_filename, "w" );
+  if ( l_fptr == nullptr )
+  {
+    fprintf( stderr, "Unable to write %s\n", p_filename );
+    return false;
+  }
+  for ( l_index = 0; l_index < m_frame_count; l_index++ )
+  {
+    fprintf( l_fptr, "%08x %s\n", m_frames[l_index].hash, m_frames[l_index].label );
+  }
+  fclose( l_fptr );
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * check_push - runs the scenes of the golden frame sweep as the render loop
+ *              would, pushing only what changed to the Unicorn after each
+ *              frame, and varying the brightness as it goes. After every frame
+ *              the Unicorn must hold exactly what a full update() of the
+ *              framebuffer would have given it. Returns the number of frames
+ *              that differ.
+ */
+
+static int host_check_push( uc_unicorn_t *p_unicorn, pimoroni::PicoGraphics *p_graphics, 
+                            const uc_config_t *p_config )
+{
+  static const char    *l_scene_faces[] = 
+    { "standard", "large", "binary", "progress", "seconds", "date", "timezone", "standard" };
+  static const uint8_t  l_levels[] = { 255, 96, 160, 200, 100, 128 };
+  static uc_unicorn_t   l_reference;
+  datetime_t            l_time;
+  uint_fast8_t          l_scene, l_frame;
+  uint_fast16_t         l_minutes, l_step = 0;
+  uint32_t              l_frames = 0, l_pushed = 0;
+  int                   l_failures = 0;
+
+  /* A fixed date, as the golden frames use. */
+  l_time.year = 2023;
+  l_time.month = 6;
+  l_time.day = 21;
+  l_time.dotw = 3;
+
+  for ( l_scene = 0; l_scene < UC_GOLDEN_SCENES; l_scene++ )
+  {
+    display_set_face( l_scene_faces[l_scene], true );
+    for ( l_minutes = 0; l_minutes < 24 * 60; l_minutes += UC_GOLDEN_STEP_MINS )
+    {
+      l_time.hour = l_minutes / 60;
+      l_time.min = l_minutes % 60;
+      l_time.sec = ( l_minutes / UC_GOLDEN_STEP_MINS ) % 60;
+      host_set_datetime( &l_time );
+
+      /* The transient scenes are asked for just as the buttons would. */
+      if ( strcmp( l_scene_faces[l_scene], "date" ) == 0 )
+      {
+        display_date();
+      }
+      else if ( strcmp( l_scene_faces[l_scene], "timezone" ) == 0 )
+      {
+        display_timezone();
+      }
+      else if ( l_scene == UC_GOLDEN_SCENES - 1 )
+      {
+        display_show_brightness();
+      }
+
+      /* Move the brightness, and let it ramp over a few frames. */
+      display_set_brightness( l_levels[l_step++ % sizeof( l_levels )] );
+      for ( l_frame = 0; l_frame < UC_HOST_PUSH_FRAMES; l_frame++ )
+      {
+        if ( display_render( p_config ) )
+        {
+          display_push();
+        }
+        l_frames++;
+
+        /* A full update, at the same brightness, must give the same pixels. */
+        l_reference.brightness = p_unicorn->brightness;
+        l_reference.update( p_graphics );
+        if ( memcmp( l_reference.pixels, p_unicorn->pixels, sizeof( l_reference.pixels ) ) != 0 )
+        {
+          fprintf( stderr, "Pushed frame differs from update: %s %02d:%02d:%02d, frame %u\n", 
+                   l_scene_faces[l_scene], l_time.hour, l_time.min, l_time.sec, (unsigned)l_frame );
+          l_failures++;
+        }
+      }
+    }
+  }
+
+  /* Say how much pushing saved, over updating every frame. */
+  l_pushed = p_unicorn->pixels_set;
+  printf( "%" PRIu32 " frames pushed %" PRIu32 " pixels, against %" PRIu32 " for update\n", 
+          l_frames, l_pushed, l_frames * UC_PANEL_WIDTH * UC_PANEL_HEIGHT );
+
+  /* All done. */
+  return l_failures;
+}
+
+
+/* Functions.*/
+
+/*
+ * main - sets the display up just as the clock would, runs the golden frame
+ *        sweep, and then does whatever was asked with the frames.
+ */
+
+int main( int argc, char **argv )
+{
+  const char                 *l_frames_dir = nullptr, *l_check = nullptr, *l_update = nullptr;
+  pimoroni::PicoGraphics     *l_graphics;
+  uc_unicorn_t               *l_unicorn;
+  uc_config_t                 l_config;
+  uc_display_stats_t          l_stats;
+  const uint8_t              *l_output;
+  size_t                      l_length;
+  int                         l_index, l_failures;
+  bool                        l_self_test = false, l_check_push = false;
+
+  /* Work out what we've been asked to do. */
+  for ( l_index = 1; l_index < argc; l_index++ )
+  {
+    if ( strcmp( argv[l_index], "--self-test" ) == 0 )
+    {
+      l_self_test = true;
+    }
+    else if ( strcmp( argv[l_index], "--check-push" ) == 0 )
+    {
+      l_check_push = true;
+    }
+    else if ( l_index == argc - 1 )
+    {
+      break;
+    }
+    else if ( strcmp( argv[l_index], "--frames" ) == 0 )
+    {
+      l_frames_dir = argv[++l_index];
+    }
+    else if ( strcmp( argv[l_index], "--check" ) == 0 )
+    {
+      l_check = argv[++l_index];
+    }
+    else if ( strcmp( argv[l_index], "--update" ) == 0 )
+    {
+      l_update = argv[++l_index];
+    }
+    else
+    {
+      break;
+    }
+  }
+  if ( l_index != argc )
+  {
+    fprintf( stderr, "Usage: %s [--self-test | --check-push] [--frames <dir>] [--check <file> | --update <file>]\n", argv[0] );
+    return 2;
+  }
+
+  /* Set up the display, just as the clock does. */
+  l_unicorn = new uc_unicorn_t();
+#ifdef UC_FRAMEBUFFER_P8
+  l_graphics = new pimoroni::PicoGraphics_PenP8( UC_PANEL_WIDTH, UC_PANEL_HEIGHT, nullptr );
+#else
+  l_graphics = new pimoroni::PicoGraphics_PenRGB565( UC_PANEL_WIDTH, UC_PANEL_HEIGHT, nullptr );
+#endif
+  display_init( l_unicorn, l_graphics );
+
+  /* With the default configuration. */
+  memset( &l_config, 0, sizeof( l_config ) );
+  strcpy( l_config.date_format, "dmy" );
+  strcpy( l_config.time_format, "HMS" );
+  strcpy( l_config.face, "standard" );
+  format_compile( l_config.date_format, '/', nullptr, &l_config.date_program );
+  format_compile( l_config.time_format, ':', nullptr, &l_config.time_program );
+  host_set_utc_offset( 60 );
+
+  /* The self test checks and times the rendering code, rather than its frames. */
+  if ( l_self_test )
+  {
+    return display_self_test( &l_config ) ? 0 : 1;
+  }
+
+  /* Checking the pushes renders the scenes itself. */
+  if ( l_check_push )
+  {
+    l_failures = host_check_push( l_unicorn, l_graphics, &l_config );
+    if ( l_failures != 0 )
+    {
+      fprintf( stderr, "%d pushed frames do not match update\n", l_failures );
+      return 1;
+    }
+    printf( "All pushed frames match update\n" );
+    return 0;
+  }
+
+  /* Run through the golden frames, which reports the timings as it goes. */
+  display_golden_frames( &l_config );
+  display_take_stats( &l_stats );
+  display_report_stats( &l_stats );
+
+  /* Pick the frames out of what was sent, and do what we were asked. */
+  l_output = host_debug_output( &l_length );
+  if ( !host_split_frames( l_output, l_length ) )
+  {
+    return 1;
+  }
+  printf( "%u frames rendered\n", (unsigned)m_frame_count );
+  if ( ( l_frames_dir != nullptr ) && !host_save_frames( l_frames_dir ) )
+  {
+    return 1;
+  }
+  if ( ( l_update != nullptr ) && !host_update_frames( l_update ) )
+  {
+    return 1;
+  }
+  if ( l_check != nullptr )
+  {
+    l_failures = host_check_frames( l_check );
+    if ( l_failures != 0 )
+    {
+      fprintf( stderr, "%d frames do not match %s\n", l_failures, l_check );
+      return 1;
+    }
+    printf( "All frames match %s\n", l_check );
+  }
+
+  /* All done. */
+  return 0;
+}
+
+
+/* End of file uniclock_host.cpp */
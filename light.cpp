@@ -0,0 +1,210 @@
+/*
+ * light.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Ambient light sensing; the ADC runs freely on the light sensor, with DMA
+ * dropping the samples into a small ring buffer. We then filter whatever is
+ * in that buffer whenever we're asked, so the sampling itself costs the main
+ * loop nothing at all.
+ * 
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+#include "usbfs.hpp"
+
+
+/* Module variables. */
+
+static uint16_t   m_light_samples[UC_LIGHT_SAMPLES] 
+                    __attribute__((aligned(UC_LIGHT_SAMPLES * sizeof(uint16_t))));
+static uint       m_light_dma;
+static int32_t    m_light_filtered;
+static uint16_t   m_light_level;
+static uint32_t   m_light_count;
+static absolute_time_t m_light_moved;
+
+
+/* Local functions. */
+
+/*
+ * start - sets the ADC running on the light sensor, and DMA copying those
+ *         samples round our ring buffer. The Unicorn's own init() resets the
+ *         ADC, so this has to happen after that, and again if it ever stalls.
+ */
+
+static void light_start( void )
+{
+  dma_channel_config  l_config;
+
+  /* Point the ADC at the light sensor. */
+  adc_init();
+  adc_gpio_init( uc_unicorn_t::LIGHT_SENSOR );
+  adc_select_input( uc_unicorn_t::LIGHT_SENSOR - 26 );
+
+  /* Have it feed samples into the FIFO, at a fairly leisurely rate. */
+  adc_fifo_setup( true, true, 1, false, false );
+  adc_set_clkdiv( ( 48000000 / UC_LIGHT_SAMPLE_HZ ) - 1 );
+
+  /* DMA then moves them into our buffer, wrapping round when it's full. */
+  dma_channel_abort( m_light_dma );
+  l_config = dma_channel_get_default_config( m_light_dma );
+  channel_config_set_transfer_data_size( &l_config, DMA_SIZE_16 );
+  channel_config_set_read_increment( &l_config, false );
+  channel_config_set_write_increment( &l_config, true );
+  channel_config_set_ring( &l_config, true, __builtin_ctz( sizeof( m_light_samples ) ) );
+  channel_config_set_dreq( &l_config, DREQ_ADC );
+  dma_channel_configure( m_light_dma, &l_config, m_light_samples, &adc_hw->fifo,
+                         UINT32_MAX, true );
+
+  /* And start it off. */
+  m_light_count = UINT32_MAX;
+  m_light_moved = get_absolute_time();
+  adc_run( true );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * sampling - checks that samples are still arriving, going by the DMA transfer
+ *            count; it should move several times in UC_LIGHT_START_MS.
+ */
+
+static bool light_sampling( void )
+{
+  uint32_t  l_count = dma_channel_hw_addr( m_light_dma )->transfer_count;
+
+  /* If it's moved, note when, and all is well. */
+  if ( l_count != m_light_count )
+  {
+    m_light_count = l_count;
+    m_light_moved = get_absolute_time();
+    return true;
+  }
+
+  /* Otherwise, it's only a problem if it's been still for a while. */
+  return absolute_time_diff_us( m_light_moved, get_absolute_time() ) < UC_LIGHT_START_MS * 1000;
+}
+
+
+/* Functions.*/
+
+/*
+ * init - starts the light sensor sampling, and checks that it is.
+ */
+
+void light_init( void )
+{
+  absolute_time_t l_deadline;
+
+  /* Prime the filter with something sensible. */
+  memset( m_light_samples, 0, sizeof( m_light_samples ) );
+  m_light_filtered = 0;
+  m_light_level = 0;
+
+  /* Start things going. */
+  m_light_dma = dma_claim_unused_channel( true );
+  light_start();
+
+  /* And give it a few samples' time to show that it's working. */
+  l_deadline = make_timeout_time_ms( UC_LIGHT_START_MS );
+  while ( ( dma_channel_hw_addr( m_light_dma )->transfer_count == UINT32_MAX ) &&
+          !time_reached( l_deadline ) )
+  {
+    tight_loop_contents();
+  }
+  if ( dma_channel_hw_addr( m_light_dma )->transfer_count == UINT32_MAX )
+  {
+    usb_debug( "Light sensor is not producing samples" );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * update - filters the current set of samples; the median of the buffer
+ *          throws away any odd spikes, and an exponential filter over that
+ *          smooths out the rest. Small wobbles in the result are ignored.
+ */
+
+void light_update( void )
+{
+  uint16_t      l_sorted[UC_LIGHT_SAMPLES];
+  uint16_t      l_sample;
+  uint_fast8_t  l_index, l_slot;
+  int32_t       l_delta;
+
+  /* 
+   * In the unlikely event that DMA has run through its (very large) transfer
+   * count, just set it going again.
+   */
+  if ( !dma_channel_is_busy( m_light_dma ) )
+  {
+    dma_channel_set_trans_count( m_light_dma, UINT32_MAX, true );
+  }
+
+  /* If the samples have stopped arriving, something has reset the ADC. */
+  if ( !light_sampling() )
+  {
+    usb_debug( "Light sensor stalled, restarting it" );
+    light_start();
+  }
+
+  /* Take a copy of the samples, sorting them as we go. */
+  for ( l_index = 0; l_index < UC_LIGHT_SAMPLES; l_index++ )
+  {
+    l_sample = m_light_samples[l_index] & 0x0fff;
+    for ( l_slot = l_index; ( l_slot > 0 ) && ( l_sorted[l_slot-1] > l_sample ); l_slot-- )
+    {
+      l_sorted[l_slot] = l_sorted[l_slot-1];
+    }
+    l_sorted[l_slot] = l_sample;
+  }
+
+  /* And move the filtered level a little way towards the median. */
+  l_delta = ( l_sorted[UC_LIGHT_SAMPLES/2] << 4 ) - m_light_filtered;
+  m_light_filtered += l_delta / ( 1 << UC_LIGHT_EMA_SHIFT );
+
+  /* Only take notice of the new level if it's moved far enough. */
+  if ( abs( ( m_light_filtered >> 4 ) - m_light_level ) > UC_LIGHT_HYSTERESIS )
+  {
+    m_light_level = m_light_filtered >> 4;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * level - returns the current filtered light level, in the same 0-4095 range
+ *         as the raw sensor.
+ */
+
+uint16_t light_level( void )
+{
+  return m_light_level;
+}
+
+
+/* End of file light.cpp */
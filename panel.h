@@ -0,0 +1,229 @@
+/*
+ * panel.h - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Where everything goes on the display. The same clock can be built for the
+ * Galactic, Cosmic or Stellar Unicorn, and rather than working positions out
+ * as we run, the layout for the chosen panel is calculated by the compiler
+ * and checked to fit, so drawing code just uses the numbers.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+#pragma once
+
+/* Constants. */
+
+#define UC_TIME_CELLS         8
+#define UC_DIGIT_CELL_WIDTH   5
+#define UC_COLON_CELL_WIDTH   2
+
+
+/* Structures. */
+
+typedef struct
+{
+  int32_t   text_y;
+  int32_t   time_x[UC_TIME_CELLS];
+  int32_t   time_y[UC_TIME_CELLS];
+  int32_t   window_left, window_right, window_top, window_bottom;
+  int32_t   binary_x, binary_y, binary_width, binary_pitch;
+  int32_t   binary_pair_step, binary_digit_step;
+  int32_t   progress_x, progress_y, progress_width;
+  int32_t   large_scale, large_rows, large_height;
+  int32_t   large_y[2];
+  int32_t   seconds_scale, seconds_x, seconds_y, seconds_height, sweep_y;
+} uc_panel_layout_t;
+
+
+/* Layout calculation. */
+
+/*
+ * panel_cell_width - the width of a cell of "HH:MM:SS".
+ */
+
+constexpr int32_t uc_panel_cell_width( int32_t p_cell )
+{
+  return ( ( p_cell % 3 ) == 2 ) ? UC_COLON_CELL_WIDTH : UC_DIGIT_CELL_WIDTH;
+}
+
+
+/*
+ * panel_layout - works out the layout for a panel of the given size. The
+ *                time is "HH:MM:SS" on one row if it fits, "HH:MM" over "SS"
+ *                if not, or failing that just "HH" over "MM"; everything
+ *                else scales down to suit. Cells that aren't shown have an
+ *                x of -1.
+ */
+
+constexpr uc_panel_layout_t uc_panel_layout( int32_t p_width, int32_t p_height )
+{
+  uc_panel_layout_t l_layout = {};
+  int32_t           l_rows[UC_TIME_CELLS] = {};
+  int32_t           l_row_widths[2] = {};
+  int32_t           l_row_count = 1, l_pitch = 0, l_top = 0;
+  int32_t           l_row = 0, l_cell = 0, l_x = 0, l_scale = 0;
+
+  /* Single lines of text are just centred vertically. */
+  l_layout.text_y = ( p_height - UC_GLYPH_INK_HEIGHT ) / 2;
+
+  /* Decide which row each cell of the time goes on, if any. */
+  for ( l_cell = 0; l_cell < UC_TIME_CELLS; l_cell++ )
+  {
+    if ( p_width > 6 * UC_DIGIT_CELL_WIDTH + 2 * UC_COLON_CELL_WIDTH )
+    {
+      l_rows[l_cell] = 0;
+    }
+    else if ( p_width > 4 * UC_DIGIT_CELL_WIDTH + UC_COLON_CELL_WIDTH )
+    {
+      l_rows[l_cell] = ( l_cell < 5 ) ? 0 : ( l_cell == 5 ) ? -1 : 1;
+    }
+    else
+    {
+      l_rows[l_cell] = ( l_cell < 2 ) ? 0 : ( ( l_cell == 3 ) || ( l_cell == 4 ) ) ? 1 : -1;
+    }
+    if ( l_rows[l_cell] >= 0 )
+    {
+      l_row_widths[l_rows[l_cell]] += uc_panel_cell_width( l_cell );
+      l_row_count = l_rows[l_cell] + 1;
+    }
+  }
+
+  /* Rows are spaced out a little, if there's room, and centred as a block. */
+  l_pitch = UC_GLYPH_HEIGHT + 1;
+  if ( ( l_row_count > 1 ) && ( UC_GLYPH_HEIGHT + l_pitch > p_height ) )
+  {
+    l_pitch = p_height - UC_GLYPH_HEIGHT;
+  }
+  l_top = ( p_height - ( ( l_row_count - 1 ) * l_pitch + UC_GLYPH_INK_HEIGHT ) ) / 2;
+
+  /* And then place each cell along its row, centring each row. */
+  l_layout.window_left = p_width;
+  l_layout.window_right = 0;
+  for ( l_row = 0; l_row < l_row_count; l_row++ )
+  {
+    l_x = ( p_width - l_row_widths[l_row] + 1 ) / 2;
+    if ( l_x < l_layout.window_left )
+    {
+      l_layout.window_left = l_x;
+    }
+    if ( l_x + l_row_widths[l_row] > l_layout.window_right )
+    {
+      l_layout.window_right = l_x + l_row_widths[l_row];
+    }
+    for ( l_cell = 0; l_cell < UC_TIME_CELLS; l_cell++ )
+    {
+      if ( l_rows[l_cell] == l_row )
+      {
+        l_layout.time_x[l_cell] = l_x;
+        l_layout.time_y[l_cell] = l_top + l_row * l_pitch;
+        l_x += uc_panel_cell_width( l_cell );
+      }
+      else if ( l_rows[l_cell] < 0 )
+      {
+        l_layout.time_x[l_cell] = l_layout.time_y[l_cell] = -1;
+      }
+    }
+  }
+
+  /* The gradient background leaves a dark window, with rounded corners. */
+  l_layout.window_left = ( l_layout.window_left > 2 ) ? l_layout.window_left - 2 : 0;
+  l_layout.window_right = ( l_layout.window_right < p_width ) ? l_layout.window_right : p_width - 1;
+  l_layout.window_top = ( l_top > 1 ) ? l_top - 1 : 0;
+  l_layout.window_bottom = l_top + ( l_row_count - 1 ) * l_pitch + UC_GLYPH_INK_HEIGHT;
+  l_layout.window_bottom = ( l_layout.window_bottom < p_height ) ? l_layout.window_bottom : p_height - 1;
+
+  /* Binary digits are spaced out in pairs, as far as there's room to. */
+  l_layout.binary_width = ( p_width - 1 - 16 ) / 6;
+  l_layout.binary_pair_step = 2;
+  l_layout.binary_digit_step = 5;
+  if ( l_layout.binary_width < 1 )
+  {
+    l_layout.binary_width = ( p_width - 1 - 7 ) / 6;
+    l_layout.binary_pair_step = 1;
+    l_layout.binary_digit_step = 2;
+  }
+  l_layout.binary_width = ( l_layout.binary_width > 3 ) ? 3 : l_layout.binary_width;
+  l_layout.binary_x = ( p_width - 1 - ( 6 * l_layout.binary_width + 3 * l_layout.binary_pair_step +
+                                        2 * l_layout.binary_digit_step ) ) / 2;
+  l_layout.binary_pair_step += l_layout.binary_width;
+  l_layout.binary_digit_step += l_layout.binary_width;
+  l_layout.binary_pitch = ( p_height + 1 ) / 4;
+  l_layout.binary_y = ( p_height - ( 4 * l_layout.binary_pitch - 1 ) ) / 2;
+
+  /* The day progress bar runs the width of the display. */
+  l_layout.progress_x = 1;
+  l_layout.progress_width = p_width - 2;
+  l_layout.progress_y = p_height - 9 - ( p_height - 11 ) / 2;
+
+  /* Large digits are as big as will fit; split over two rows if that's bigger. */
+  l_layout.large_rows = 1;
+  l_layout.large_scale = ( p_width - 1 ) / ( 4 * UC_DIGIT_CELL_WIDTH + UC_COLON_CELL_WIDTH );
+  l_scale = ( p_width - 1 ) / ( 2 * UC_DIGIT_CELL_WIDTH - 1 );
+  if ( l_scale > p_height / ( 2 * UC_GLYPH_INK_HEIGHT + 1 ) )
+  {
+    l_scale = p_height / ( 2 * UC_GLYPH_INK_HEIGHT + 1 );
+  }
+  if ( l_scale > l_layout.large_scale )
+  {
+    l_layout.large_rows = 2;
+    l_layout.large_scale = l_scale;
+  }
+  l_layout.large_scale = ( l_layout.large_scale > 2 ) ? 2 : l_layout.large_scale;
+  l_layout.large_height = l_layout.large_scale * UC_GLYPH_INK_HEIGHT;
+  l_layout.large_height = ( l_layout.large_height > p_height ) ? p_height : l_layout.large_height;
+  l_layout.large_y[0] = ( p_height - ( l_layout.large_rows * ( l_layout.large_height + l_layout.large_scale ) -
+                                       l_layout.large_scale ) ) / 2;
+  l_layout.large_y[1] = l_layout.large_y[0] + l_layout.large_height + l_layout.large_scale;
+
+  /* And seconds, leaving room for the sweep along the bottom. */
+  l_layout.seconds_scale = ( p_width - 1 ) / ( 2 * UC_DIGIT_CELL_WIDTH - 1 );
+  l_layout.seconds_scale = ( l_layout.seconds_scale > 3 ) ? 3 : l_layout.seconds_scale;
+  l_layout.seconds_x = ( p_width - 1 - ( 2 * UC_DIGIT_CELL_WIDTH - 1 ) * l_layout.seconds_scale ) / 2;
+  l_layout.seconds_height = l_layout.seconds_scale * UC_GLYPH_INK_HEIGHT;
+  l_layout.seconds_height = ( l_layout.seconds_height > p_height - 2 ) ? p_height - 2 : l_layout.seconds_height;
+  l_layout.seconds_y = ( p_height - 2 - l_layout.seconds_height ) / 2;
+  l_layout.sweep_y = p_height - 1;
+
+  /* All done. */
+  return l_layout;
+}
+
+
+/*
+ * panel_fits - checks that everything in a layout lands on the display, so
+ *              that the drawing code doesn't need to check for itself.
+ */
+
+constexpr bool uc_panel_fits( const uc_panel_layout_t &p_layout, int32_t p_width, int32_t p_height )
+{
+  for ( int32_t l_cell = 0; l_cell < UC_TIME_CELLS; l_cell++ )
+  {
+    if ( ( p_layout.time_x[l_cell] >= 0 ) &&
+         ( ( p_layout.time_y[l_cell] < 0 ) || ( p_layout.time_y[l_cell] + UC_GLYPH_HEIGHT > p_height ) ||
+           ( p_layout.time_x[l_cell] + uc_panel_cell_width( l_cell ) > p_width - 1 ) ) )
+    {
+      return false;
+    }
+  }
+  return ( p_layout.text_y >= 0 ) && ( p_layout.text_y + UC_GLYPH_HEIGHT <= p_height ) &&
+         ( p_layout.time_x[0] >= 0 ) && ( p_layout.time_x[1] >= 0 ) &&
+         ( p_layout.binary_width > 0 ) && ( p_layout.binary_x >= 0 ) && ( p_layout.binary_y >= 0 ) &&
+         ( p_layout.progress_y >= 0 ) && ( p_layout.progress_y + 9 <= p_height ) &&
+         ( p_layout.large_scale > 0 ) && ( p_layout.large_y[0] >= 0 ) &&
+         ( p_layout.large_y[p_layout.large_rows-1] + p_layout.large_height <= p_height ) &&
+         ( p_layout.seconds_scale > 0 ) && ( p_layout.seconds_x >= 0 ) && ( p_layout.seconds_y >= 0 );
+}
+
+
+/* The layout for the panel we're being built for, checked as we build. */
+
+constexpr uc_panel_layout_t uc_panel = uc_panel_layout( UC_PANEL_WIDTH, UC_PANEL_HEIGHT );
+static_assert( uc_panel_fits( uc_panel, UC_PANEL_WIDTH, UC_PANEL_HEIGHT ),
+               "The display layout doesn't fit on this panel" );
+
+
+/* End of file panel.h */
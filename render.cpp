@@ -0,0 +1,413 @@
+/*
+ * render.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Rendering runs on core1, well away from the NTP, USB and filesystem work on
+ * core0, any of which can hold things up for a while. Core0 hands over all
+ * that the display needs to know as snapshots, through a single producer,
+ * single consumer queue; each side only ever moves its own end of the queue,
+ * so no locks are needed. Anything core1 wants reported goes back the other
+ * way, through a single slot, so that only core0 ever writes to USB.
+ *
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+/* Local headers. */
+
+#include "uniclock.h"
+#include "usbfs.hpp"
+#include "libraries/pico_graphics/pico_graphics.hpp"
+
+
+/* Module variables. */
+
+typedef struct
+{
+  uc_display_stats_t  stats;
+  bool                stats_valid;
+  uint32_t            over_budget_us;
+} uc_render_report_t;
+
+static uc_unicorn_t              *m_unicorn;
+static uc_snapshot_t              m_queue[UC_SNAPSHOT_QUEUE];
+static volatile uint32_t          m_queue_head, m_queue_tail;
+static uc_snapshot_t              m_pending;
+static bool                       m_pending_valid;
+static uc_snapshot_t              m_snapshot;
+static volatile bool              m_core1_ready;
+static uc_render_report_t         m_report, m_report_pending;
+static volatile bool              m_report_ready;
+
+
+/* Local functions. */
+
+/*
+ * push - adds a snapshot to the queue, if there's room; only ever called by
+ *        core0. The snapshot is copied in before the head is moved on, so
+ *        core1 never sees a half-written one.
+ */
+
+static bool render_push( const uc_snapshot_t *p_snapshot )
+{
+  uint32_t  l_head = m_queue_head;
+
+  /* If the queue is full, the caller will have to try again later. */
+  if ( l_head - m_queue_tail >= UC_SNAPSHOT_QUEUE )
+  {
+    return false;
+  }
+
+  /* Copy it in, and only then let core1 know it's there. */
+  m_queue[l_head % UC_SNAPSHOT_QUEUE] = *p_snapshot;
+  __dmb();
+  m_queue_head = l_head + 1;
+  __sev();
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * pop - takes the oldest snapshot off the queue, if there is one; only ever
+ *       called by core1. Core0 is woken up in case it's waiting for room.
+ */
+
+static bool render_pop( uc_snapshot_t *p_snapshot )
+{
+  uint32_t  l_tail = m_queue_tail;
+
+  /* Nothing to do if the queue is empty. */
+  if ( l_tail == m_queue_head )
+  {
+    return false;
+  }
+
+  /* Copy it out, and only then hand the slot back to core0. */
+  __dmb();
+  *p_snapshot = m_queue[l_tail % UC_SNAPSHOT_QUEUE];
+  __dmb();
+  m_queue_tail = l_tail + 1;
+  __sev();
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * send_report - hands anything core1 has to report over to core0, to be
+ *               written out to USB; only ever called by core1. If core0 is
+ *               still busy with the last one, it waits for the next frame.
+ */
+
+static void render_send_report( void )
+{
+  /* Nothing to do if there's nothing to say, or nowhere to put it yet. */
+  if ( ( !m_report_pending.stats_valid && ( m_report_pending.over_budget_us == 0 ) ) ||
+       m_report_ready )
+  {
+    return;
+  }
+
+  /* Copy it in, and only then let core0 know it's there. */
+  m_report = m_report_pending;
+  __dmb();
+  m_report_ready = true;
+  __sev();
+
+  /* And start afresh. */
+  m_report_pending.stats_valid = false;
+  m_report_pending.over_budget_us = 0;
+  return;
+}
+
+
+/*
+ * apply - brings the display up to date with a snapshot from core0. Returns
+ *         true if the user asked for something, and so wants to see a new
+ *         frame straight away.
+ */
+
+static bool render_apply( const uc_snapshot_t *p_snapshot )
+{
+  /* The brightness is always sent, and the display ramps towards it. */
+  display_set_brightness( p_snapshot->brightness );
+
+  /* Then work through anything that's changed. */
+  if ( p_snapshot->actions & UC_SNAPSHOT_CONFIG )
+  {
+    display_set_face( p_snapshot->config.face, false );
+  }
+  if ( p_snapshot->actions & UC_SNAPSHOT_BRIGHTNESS )
+  {
+    display_show_brightness();
+  }
+  if ( p_snapshot->actions & UC_SNAPSHOT_TIMEZONE )
+  {
+    display_timezone();
+  }
+  if ( p_snapshot->actions & UC_SNAPSHOT_DATE )
+  {
+    display_date();
+  }
+  if ( p_snapshot->actions & UC_SNAPSHOT_FACE )
+  {
+    display_set_face( p_snapshot->config.face, true );
+  }
+#ifndef NDEBUG
+  if ( p_snapshot->actions & UC_SNAPSHOT_GOLDEN )
+  {
+    display_golden_frames( &p_snapshot->config );
+  }
+  if ( p_snapshot->actions & UC_SNAPSHOT_SELF_TEST )
+  {
+    display_self_test( &p_snapshot->config );
+  }
+#endif
+
+  /* All done; a change of configuration alone can wait for the next frame. */
+  return ( p_snapshot->actions & ~UC_SNAPSHOT_CONFIG ) != 0;
+}
+
+
+/*
+ * core1_main - the render loop, which runs on core1. Rendering is driven by
+ *              the RTC ticking over into a new second, unless the display is
+ *              showing something that needs more frequent frames; between
+ *              frames, we sleep until there's something to do.
+ */
+
+static void render_core1_main( void )
+{
+  absolute_time_t   l_next_render = nil_time, l_wake;
+  absolute_time_t   l_stats_report = make_timeout_time_ms( UC_STATS_MS );
+  uint32_t          l_frame_ms = 0, l_frame_start, l_frame_us;
+  bool              l_changed, l_configured = false;
+
+  /* Core0 needs to be able to stop us while it writes to flash. */
+  multicore_lockout_victim_init();
+
+  /* The Unicorn's refresh interrupt belongs to the core that starts it. */
+  m_unicorn->init();
+  m_core1_ready = true;
+  __sev();
+
+  /* And we never leave this loop. */
+  while( true )
+  {
+    /* Take in anything core0 has sent us; we keep the latest configuration. */
+    while ( render_pop( &m_snapshot ) )
+    {
+      if ( render_apply( &m_snapshot ) )
+      {
+        l_next_render = nil_time;
+      }
+      l_configured = true;
+    }
+
+    /* Nothing to draw until we've been told how. */
+    if ( !l_configured )
+    {
+      __wfe();
+      continue;
+    }
+
+    /* Render if the second has ticked over, or a frame is due. */
+    if ( ( time_second_elapsed() && ( display_frame_ms() == 0 ) ) ||
+         time_reached( l_next_render ) )
+    {
+      /* Note how far into the second we are, or how late the frame is. */
+      if ( l_frame_ms == 0 )
+      {
+        UC_STATS_RECORD( UC_STATS_LATENCY, time_subsecond_us() );
+      }
+      else if ( !is_nil_time( l_next_render ) && time_reached( l_next_render ) )
+      {
+        UC_STATS_RECORD( UC_STATS_JITTER, absolute_time_diff_us( l_next_render, get_absolute_time() ) );
+      }
+
+      /* Draw the display; if nothing changed, there's nothing to push. */
+      l_frame_start = time_us_32();
+      UC_STATS_BEGIN( UC_STATS_RENDER );
+      l_changed = display_render( &m_snapshot.config );
+      UC_STATS_END( UC_STATS_RENDER );
+      if ( l_changed )
+      {
+        /* Push the changes out to the unicorn. */
+        UC_STATS_BEGIN( UC_STATS_UPDATE );
+        display_push();
+        UC_STATS_END( UC_STATS_UPDATE );
+      }
+
+      /* Let the display know how long that took, to keep within budget. */
+      l_frame_us = time_us_32() - l_frame_start;
+      if ( display_frame_time( l_frame_us ) )
+      {
+        m_report_pending.over_budget_us = l_frame_us;
+      }
+
+      /*
+       * And schedule the next render; if the display is happy to wait for
+       * the next second, this is just a fallback in case that goes astray.
+       */
+      l_frame_ms = display_frame_ms();
+      l_next_render = make_timeout_time_ms( l_frame_ms > 0 ? l_frame_ms : UC_RENDER_IDLE_MS );
+
+      /* Transient displays also need a frame as soon as they run out. */
+      if ( absolute_time_diff_us( display_next_deadline(), l_next_render ) > 0 )
+      {
+        l_next_render = display_next_deadline();
+      }
+    }
+
+    /* Every so often, report on how much work the rendering is doing. */
+    if ( time_reached( l_stats_report ) )
+    {
+      if ( !m_report_pending.stats_valid )
+      {
+        display_take_stats( &m_report_pending.stats );
+        m_report_pending.stats_valid = true;
+      }
+      l_stats_report = make_timeout_time_ms( UC_STATS_MS );
+    }
+
+    /* Anything worth reporting goes to core0, which owns USB. */
+    render_send_report();
+
+    /* Sleep until the next frame; the RTC second and core0 will wake us. */
+    l_wake = l_next_render;
+    if ( absolute_time_diff_us( l_stats_report, l_wake ) > 0 )
+    {
+      l_wake = l_stats_report;
+    }
+    if ( !time_reached( l_wake ) )
+    {
+      best_effort_wfe_or_timeout( l_wake );
+    }
+  }
+}
+
+
+/* Functions.*/
+
+/*
+ * init - sets up the display, and starts core1 running the render loop. We
+ *        wait for it to start the Unicorn, so that the buttons are ready.
+ */
+
+void render_init( uc_unicorn_t *p_unicorn, pimoroni::PicoGraphics *p_graphics )
+{
+  /* Set the display up, before core1 gets its hands on it. */
+  m_unicorn = p_unicorn;
+  display_init( p_unicorn, p_graphics );
+
+  /* Nothing has been sent yet. */
+  m_queue_head = m_queue_tail = 0;
+  m_pending_valid = false;
+  m_core1_ready = false;
+  m_report_pending.stats_valid = false;
+  m_report_pending.over_budget_us = 0;
+  m_report_ready = false;
+
+  /* And start core1 off. */
+  multicore_launch_core1( render_core1_main );
+  while( !m_core1_ready )
+  {
+    __wfe();
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * post - sends the current state over to core1, along with any actions the
+ *        user has asked for. If the queue is full, this is kept until there's
+ *        room, and anything posted in the meantime is merged into it.
+ */
+
+void render_post( const uc_config_t *p_config, uint8_t p_brightness, uint8_t p_actions )
+{
+  /* Bring the pending snapshot up to date. */
+  m_pending.config = *p_config;
+  m_pending.brightness = p_brightness;
+  m_pending.actions = m_pending_valid ? ( m_pending.actions | p_actions ) : p_actions;
+  m_pending_valid = true;
+
+  /* And try to send it. */
+  render_flush();
+  return;
+}
+
+
+/*
+ * flush - sends any snapshot that's been waiting for room in the queue;
+ *         called regularly by core0.
+ */
+
+void render_flush( void )
+{
+  /* Simple enough; if it goes, it's no longer pending. */
+  if ( m_pending_valid && render_push( &m_pending ) )
+  {
+    m_pending_valid = false;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * report - writes out anything core1 has posted back to us; called regularly
+ *          by core0, as core1 must never block on USB itself.
+ */
+
+void render_report( void )
+{
+  uc_render_report_t  l_report;
+
+  /* Nothing to do if core1 hasn't sent anything. */
+  if ( !m_report_ready )
+  {
+    return;
+  }
+
+  /* Copy it out, and only then hand the slot back to core1. */
+  __dmb();
+  l_report = m_report;
+  __dmb();
+  m_report_ready = false;
+
+  /* And report whatever it holds. */
+  if ( l_report.over_budget_us != 0 )
+  {
+    usb_debug( "Frame over budget (%" PRIu32 "us), suspending animation", l_report.over_budget_us );
+  }
+  if ( l_report.stats_valid )
+  {
+    display_report_stats( &l_report.stats );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file render.cpp */
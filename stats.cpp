@@ -0,0 +1,225 @@
+/*
+ * stats.cpp - part of UniClock, a Clock for the Galactic Unicorn.
+ *
+ * UniClock is an enhance clock / calendar display for the beautiful Galactic
+ * Unicorn.
+ *
+ * Instrumentation, to keep track of how long each stage of the main loop
+ * takes. Timings are kept as histograms, and dumped to the debug channel on
+ * request. None of this is built in release builds; the UC_STATS_ macros in
+ * uniclock.h compile away to nothing.
+ *
+ * Stages are timed on both cores, so the histograms are only ever touched
+ * while holding a spin lock; the reporting itself is done outside of it.
+ * 
+ * Copyright (C) 2023 Pete Favelle <ahnlak@ahnlak.com>
+ * Released under the MIT License; see LICENSE for details.
+ */
+
+/* System headers. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+
+/* Local headers. */
+
+#include "uniclock.h"
+#include "usbfs.hpp"
+
+
+/* Module variables. */
+
+typedef struct
+{
+  uint32_t  count;
+  uint64_t  total_us;
+  uint32_t  min_us, max_us;
+  uint32_t  started_us;
+  uint32_t  buckets[UC_STATS_BUCKETS];
+} uc_stats_stage_data_t;
+
+static uc_stats_stage_data_t  m_stages[UC_STATS_STAGES];
+static spin_lock_t           *m_stats_lock;
+static const char            *m_stage_names[UC_STATS_STAGES] = {
+  "render", "update", "usb", "config", "ntp", "latency", "jitter"
+};
+
+
+/* Local functions. */
+
+/*
+ * bucket - works out which histogram bucket a timing falls into. Buckets are
+ *          log-linear; each power of two is split into four, which keeps the
+ *          error on a percentile under 25% without needing many buckets.
+ */
+
+static uint_fast8_t stats_bucket( uint32_t p_value )
+{
+  uint_fast8_t  l_msb;
+
+  /* Small values have a bucket each. */
+  if ( p_value < 4 )
+  {
+    return p_value;
+  }
+
+  /* Otherwise, find the top bit and use the two below it. */
+  l_msb = 31 - __builtin_clz( p_value );
+  return ( ( l_msb - 1 ) * 4 ) + ( ( p_value >> ( l_msb - 2 ) ) & 3 );
+}
+
+
+/*
+ * bucket_limit - returns the largest value which falls into a bucket.
+ */
+
+static uint32_t stats_bucket_limit( uint_fast8_t p_bucket )
+{
+  uint_fast8_t  l_msb;
+
+  /* Small values are easy. */
+  if ( p_bucket < 4 )
+  {
+    return p_bucket;
+  }
+
+  /* Otherwise, reverse the sums in stats_bucket. */
+  l_msb = ( p_bucket / 4 ) + 1;
+  return ( ( ( 4 + ( p_bucket % 4 ) + 1 ) << ( l_msb - 2 ) ) - 1 );
+}
+
+
+/* Functions.*/
+
+/*
+ * init - sets up the lock that keeps the two cores out of each other's way;
+ *        called before core1 is started.
+ */
+
+void stats_init( void )
+{
+  m_stats_lock = spin_lock_init( spin_lock_claim_unused( true ) );
+  memset( m_stages, 0, sizeof( m_stages ) );
+  return;
+}
+
+
+/*
+ * begin - notes the start of a stage.
+ */
+
+void stats_begin( uc_stats_stage_t p_stage )
+{
+  m_stages[p_stage].started_us = time_us_32();
+  return;
+}
+
+
+/*
+ * end - notes the end of a stage, and records how long it took.
+ */
+
+void stats_end( uc_stats_stage_t p_stage )
+{
+  stats_record( p_stage, time_us_32() - m_stages[p_stage].started_us );
+  return;
+}
+
+
+/*
+ * record - adds a timing to a stage's histogram.
+ */
+
+void stats_record( uc_stats_stage_t p_stage, uint32_t p_time_us )
+{
+  uc_stats_stage_data_t  *l_stage = &m_stages[p_stage];
+  uint32_t                l_status;
+
+  /* Keep the simple counts up to date. */
+  l_status = spin_lock_blocking( m_stats_lock );
+  if ( ( l_stage->count == 0 ) || ( p_time_us < l_stage->min_us ) )
+  {
+    l_stage->min_us = p_time_us;
+  }
+  if ( p_time_us > l_stage->max_us )
+  {
+    l_stage->max_us = p_time_us;
+  }
+  l_stage->count++;
+  l_stage->total_us += p_time_us;
+
+  /* And the histogram. */
+  l_stage->buckets[stats_bucket( p_time_us )]++;
+  spin_unlock( m_stats_lock, l_status );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * dump - sends a summary of all the stages out to the debug channel, and then
+ *        resets them ready for the next lot.
+ */
+
+void stats_dump( void )
+{
+  uint_fast8_t            l_stage, l_bucket;
+  uint32_t                l_seen, l_p99_count, l_p99, l_status;
+  uc_stats_stage_data_t   l_copy, *l_data = &l_copy;
+
+  /* Work through each stage. */
+  for ( l_stage = 0; l_stage < UC_STATS_STAGES; l_stage++ )
+  {
+    /*
+     * Take a copy and start the stage again from scratch, in one go; a stage
+     * may be part way through being timed, so its start is left alone.
+     */
+    l_status = spin_lock_blocking( m_stats_lock );
+    l_copy = m_stages[l_stage];
+    memset( &m_stages[l_stage], 0, sizeof( m_stages[l_stage] ) );
+    m_stages[l_stage].started_us = l_copy.started_us;
+    spin_unlock( m_stats_lock, l_status );
+
+    if ( l_data->count == 0 )
+    {
+      usb_debug( "%-7s no samples", m_stage_names[l_stage] );
+      continue;
+    }
+
+    /* Find the bucket that the 99th percentile falls into. */
+    l_p99_count = l_data->count - ( l_data->count / 100 );
+    l_seen = 0;
+    l_p99 = l_data->max_us;
+    for ( l_bucket = 0; l_bucket < UC_STATS_BUCKETS; l_bucket++ )
+    {
+      l_seen += l_data->buckets[l_bucket];
+      if ( l_seen >= l_p99_count )
+      {
+        l_p99 = stats_bucket_limit( l_bucket );
+        break;
+      }
+    }
+    if ( l_p99 > l_data->max_us )
+    {
+      l_p99 = l_data->max_us;
+    }
+
+    /* And report it all. */
+    usb_debug( "%-7s n=%" PRIu32 " min=%" PRIu32 " avg=%" PRIu32 " p99=%" PRIu32 " max=%" PRIu32, 
+               m_stage_names[l_stage], l_data->count, l_data->min_us,
+               (uint32_t)( l_data->total_us / l_data->count ), l_p99, l_data->max_us );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file stats.cpp */
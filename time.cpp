@@ -20,6 +20,7 @@
 #include "pico/stdlib.h"
 #include "pico/cyw43_arch.h"
 #include "hardware/rtc.h"
+#include "hardware/sync.h"
 #include "lwip/dns.h"
 #include "lwip/pbuf.h"
 #include "lwip/udp.h"
@@ -35,10 +36,105 @@
 
 static absolute_time_t    m_next_ntp_check = nil_time;
 static int16_t            m_utc_offset = 0;
+static datetime_t         m_second_alarm;
+static volatile bool      m_second_elapsed = false;
+static volatile uint32_t  m_second_edge_us = 0;
+static spin_lock_t       *m_rtc_lock;
+#ifndef NDEBUG
+static datetime_t         m_override_time;
+static bool               m_override_active = false;
+#endif
 
 
 /* Local / callback functions; not expected to be called from outside. */
 
+/*
+ * rtc_get - reads the RTC. Core1 reads it as it renders, while core0 may be
+ *           setting it, and reading it mid-set gives nonsense; so reads and
+ *           writes are kept apart by a spin lock.
+ */
+
+static void time_rtc_get( datetime_t *p_datetime )
+{
+  uint32_t  l_status;
+
+  /* Just hold the lock while we read it. */
+  l_status = spin_lock_blocking( m_rtc_lock );
+  rtc_get_datetime( p_datetime );
+  spin_unlock( m_rtc_lock, l_status );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * rtc_set - sets the RTC, keeping any readers out while it's done.
+ */
+
+static void time_rtc_set( datetime_t *p_datetime )
+{
+  uint32_t  l_status;
+
+  /* Just hold the lock while we set it. */
+  l_status = spin_lock_blocking( m_rtc_lock );
+  rtc_set_datetime( p_datetime );
+  spin_unlock( m_rtc_lock, l_status );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * second_alarm_cb - called by the RTC alarm on every second boundary; we note
+ *                   when it happened, and re-arm the alarm for the next one.
+ */
+
+void time_second_alarm_cb( void )
+{
+  /*
+   * Remember when this second started, and wake the main loop to see it; only
+   * the low 32 bits are kept, so that the other core can't see it half-written.
+   */
+  m_second_edge_us = time_us_32();
+  m_second_elapsed = true;
+  __sev();
+
+  /* And ask for the next second. */
+  m_second_alarm.sec = ( m_second_alarm.sec + 1 ) % 60;
+  rtc_set_alarm( &m_second_alarm, time_second_alarm_cb );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * arm_second_alarm - sets the RTC alarm to go off at the start of the second
+ *                    after the provided time; this needs doing whenever the
+ *                    RTC is set, as it may have jumped past the second we were
+ *                    waiting for. The time is the one just written, rather
+ *                    than read back, as the RTC can take a few of its own
+ *                    clock cycles to show a new setting.
+ */
+
+void time_arm_second_alarm( const datetime_t *p_datetime )
+{
+  /* Only the seconds matter, everything else is a wildcard. */
+  m_second_alarm.year = -1;
+  m_second_alarm.month = m_second_alarm.day = m_second_alarm.dotw = -1;
+  m_second_alarm.hour = m_second_alarm.min = -1;
+  m_second_alarm.sec = ( p_datetime->sec + 1 ) % 60;
+
+  /* And set it off. */
+  rtc_set_alarm( &m_second_alarm, time_second_alarm_cb );
+
+  /* All done. */
+  return;
+}
+
+
 /*
  * ntp_request - sends an NTP request to the server. 
  */
@@ -146,7 +242,8 @@ void time_set_rtc_by_utc( time_t p_utctime )
   l_datetime.sec   = l_tmstruct->tm_sec;
 
   /* And update the RTC. */
-  rtc_set_datetime( &l_datetime );
+  time_rtc_set( &l_datetime );
+  time_arm_second_alarm( &l_datetime );
 
   /* All done. */
   return;
@@ -234,7 +331,8 @@ void time_init( void )
 {
   datetime_t l_time;
 
-  /* Initialise the RTC */
+  /* Initialise the RTC, and the lock that guards it between the cores. */
+  m_rtc_lock = spin_lock_init( spin_lock_claim_unused( true ) );
   rtc_init();
 
   /* It also needs a valid time setting, before it runs. */
@@ -243,7 +341,10 @@ void time_init( void )
   l_time.day = 1;
   l_time.dotw = 0;
   l_time.hour = l_time.min = l_time.sec = 0;
-  rtc_set_datetime( &l_time );
+  time_rtc_set( &l_time );
+
+  /* Ask to be told at the start of every second. */
+  time_arm_second_alarm( &l_time );
 
   /* All done. */
   return;
@@ -445,9 +546,10 @@ void time_set_utc_offset( uc_config_t *p_config, int16_t p_offset )
   l_change = p_offset - m_utc_offset;
 
   /* Apply this to the current datetime held by the RTC. */
-  rtc_get_datetime( &l_datetime );
+  time_rtc_get( &l_datetime );
   time_add_minutes_to_datetime( &l_datetime, l_change );
-  rtc_set_datetime( &l_datetime );
+  time_rtc_set( &l_datetime );
+  time_arm_second_alarm( &l_datetime );
 
   /* Update the configuration to reflect this new setting. */
   if ( p_config != nullptr )
@@ -466,4 +568,98 @@ int16_t time_get_utc_offset( void )
   return m_utc_offset;
 }
 
+
+/*
+ * second_elapsed - returns true (once) when the RTC has ticked over into a
+ *                  new second since we were last asked.
+ */
+
+bool time_second_elapsed( void )
+{
+  /* Nothing to see if the flag isn't set. */
+  if ( !m_second_elapsed )
+  {
+    return false;
+  }
+
+  /* Clear it, so that we only report each second once. */
+  m_second_elapsed = false;
+  return true;
+}
+
+
+/*
+ * subsecond_us - returns how many microseconds we are into the current second,
+ *                based on when the RTC last ticked over.
+ */
+
+uint32_t time_subsecond_us( void )
+{
+  uint32_t  l_elapsed;
+
+  /* Simple enough, but clamp it in case the alarm is running late. */
+  l_elapsed = time_us_32() - m_second_edge_us;
+  if ( l_elapsed > 999999 )
+  {
+    return 999999;
+  }
+  return l_elapsed;
+}
+
+
+/*
+ * get_datetime - fetches the current (local) time from the RTC; debug builds
+ *                can override this with a fixed time, so that we can render
+ *                reproducible frames. Either core may set the override, so it
+ *                is guarded by the same lock as the RTC.
+ */
+
+void time_get_datetime( datetime_t *p_datetime )
+{
+  uint32_t  l_status;
+
+  l_status = spin_lock_blocking( m_rtc_lock );
+#ifndef NDEBUG
+  /* If we've been given a fixed time, use that instead. */
+  if ( m_override_active )
+  {
+    *p_datetime = m_override_time;
+    spin_unlock( m_rtc_lock, l_status );
+    return;
+  }
+#endif
+
+  /* Otherwise, it's just whatever the RTC thinks. */
+  rtc_get_datetime( p_datetime );
+  spin_unlock( m_rtc_lock, l_status );
+  return;
+}
+
+
+#ifndef NDEBUG
+/*
+ * override - fixes the time returned by time_get_datetime; passing nullptr
+ *            returns to using the RTC.
+ */
+
+void time_override( const datetime_t *p_datetime )
+{
+  uint32_t  l_status;
+
+  /* Simple enough, but keep any readers out while we change it. */
+  l_status = spin_lock_blocking( m_rtc_lock );
+  if ( p_datetime == nullptr )
+  {
+    m_override_active = false;
+  }
+  else
+  {
+    m_override_time = *p_datetime;
+    m_override_active = true;
+  }
+  spin_unlock( m_rtc_lock, l_status );
+  return;
+}
+#endif
+
 /* End of file time.cpp */
@@ -12,17 +12,19 @@
 
 /* System headers. */
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
 
 /* Local headers. */
 
 #include "uniclock.h"
 #include "usbfs.hpp"
 #include "libraries/pico_graphics/pico_graphics.hpp"
-#include "libraries/galactic_unicorn/galactic_unicorn.hpp"
 
 
 /* Module variables. */
@@ -30,6 +32,120 @@
 static uc_config_t  m_config;
 static uint32_t     m_config_stamp;
 
+static const uint     m_switches[] =
+{
+  uc_unicorn_t::SWITCH_BRIGHTNESS_UP, uc_unicorn_t::SWITCH_BRIGHTNESS_DOWN,
+  uc_unicorn_t::SWITCH_VOLUME_UP, uc_unicorn_t::SWITCH_VOLUME_DOWN,
+  uc_unicorn_t::SWITCH_C, uc_unicorn_t::SWITCH_D
+};
+#define UC_SWITCHES   ( sizeof( m_switches ) / sizeof( m_switches[0] ) )
+
+static volatile bool  m_button_pressed = false;
+static uint64_t       m_idle_since;
+static uint64_t       m_idle_us;
+static uint32_t       m_wakeups;
+
+
+/* Local / callback functions; not expected to be called from outside. */
+
+/*
+ * button_cb - called from the GPIO interrupt when a button goes down; we just
+ *             flag it, and wake the main loop to go and look.
+ */
+
+static void uniclock_button_cb( uint p_gpio, uint32_t p_events )
+{
+  /* Flag it, and make sure the main loop isn't left sleeping. */
+  m_button_pressed = true;
+  __sev();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * buttons_held - checks if any of the buttons we respond to are still down,
+ *                in which case we keep polling them while they are.
+ */
+
+static bool uniclock_buttons_held( uc_unicorn_t *p_unicorn )
+{
+  uint_fast8_t  l_index;
+
+  /* Simply check each switch in turn. */
+  for ( l_index = 0; l_index < UC_SWITCHES; l_index++ )
+  {
+    if ( p_unicorn->is_pressed( m_switches[l_index] ) )
+    {
+      return true;
+    }
+  }
+
+  /* All done, and none were pressed. */
+  return false;
+}
+
+
+/*
+ * sleep_until - sleeps until the given time, unless an interrupt wakes us
+ *               first; anything flagged by an interrupt after we decided to
+ *               sleep will have set the event flag, so we won't miss it. We
+ *               keep track of how long we spend asleep.
+ */
+
+static void uniclock_sleep_until( absolute_time_t p_wake )
+{
+  uint64_t  l_sleep_start;
+
+  /* If we're already due to be doing something, don't sleep at all. */
+  if ( time_reached( p_wake ) )
+  {
+    return;
+  }
+
+  /* Otherwise, wait for an event or the deadline, and note how long it was. */
+  l_sleep_start = time_us_64();
+  best_effort_wfe_or_timeout( p_wake );
+  m_idle_us += time_us_64() - l_sleep_start;
+  m_wakeups++;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * report_idle - sends out how much of the time since the last report we spent
+ *               asleep; the cycles spent awake are a rough proxy for how much
+ *               power we're drawing.
+ */
+
+static void uniclock_report_idle( void )
+{
+  uint64_t  l_now = time_us_64();
+  uint64_t  l_period = l_now - m_idle_since;
+  uint64_t  l_busy_us = ( l_period > m_idle_us ) ? l_period - m_idle_us : 0;
+
+  /* Report the idle percentage, busy cycles and wakeups, all per second. */
+  if ( l_period > 0 )
+  {
+    usb_debug( "Idle: %" PRIu32 ".%" PRIu32 "%%, %" PRIu32 " busy cycles/s, %" PRIu32 " wakeups/s",
+               (uint32_t)( ( m_idle_us * 100 ) / l_period ),
+               (uint32_t)( ( ( m_idle_us * 1000 ) / l_period ) % 10 ),
+               (uint32_t)( ( l_busy_us * clock_get_hz( clk_sys ) ) / l_period ),
+               (uint32_t)( ( (uint64_t)m_wakeups * 1000000 ) / l_period ) );
+  }
+
+  /* And start counting again for the next period. */
+  m_idle_since = l_now;
+  m_idle_us = 0;
+  m_wakeups = 0;
+
+  /* All done. */
+  return;
+}
+
 
 /* Functions.*/
 
@@ -44,43 +160,95 @@ int main()
   absolute_time_t             l_config_check = nil_time;
   absolute_time_t             l_dimmer_check = nil_time;
   absolute_time_t             l_input_delay = nil_time;
+  absolute_time_t             l_light_check = nil_time;
   absolute_time_t             l_ntp_check = nil_time;
-  absolute_time_t             l_next_render = nil_time;
+  absolute_time_t             l_stats_report = make_timeout_time_ms( UC_STATS_MS );
+  absolute_time_t             l_wake;
   pimoroni::PicoGraphics     *l_graphics;
-  pimoroni::GalacticUnicorn  *l_unicorn;
+  uc_unicorn_t               *l_unicorn;
   int16_t                     l_new_offset;
+  uint_fast8_t                l_index;
+  uint8_t                     l_actions = 0, l_brightness, l_level;
+  bool                        l_buttons_held = false;
 
 
   /* Initial setup stuff - first get Unicorn and Graphics objects. */
-  l_unicorn = new pimoroni::GalacticUnicorn();
+  l_unicorn = new uc_unicorn_t();
+#ifdef UC_FRAMEBUFFER_P8
+  l_graphics = new pimoroni::PicoGraphics_PenP8( 
+    uc_unicorn_t::WIDTH,
+    uc_unicorn_t::HEIGHT,
+    nullptr
+  );
+#else
   l_graphics = new pimoroni::PicoGraphics_PenRGB565( 
-    pimoroni::GalacticUnicorn::WIDTH,
-    pimoroni::GalacticUnicorn::HEIGHT,
+    uc_unicorn_t::WIDTH,
+    uc_unicorn_t::HEIGHT,
     nullptr
   );
+#endif
 
   /* And initialise all the subsystems. */
   stdio_init_all();
   ufs_init();
   usb_init();
   time_init();
-  display_init( l_unicorn, l_graphics );
-  l_unicorn->init();
+#ifndef NDEBUG
+  stats_init();
+#endif
 
   /* Fetch the current configuration. */
   m_config_stamp = config_read( &m_config );
   time_set_utc_offset( nullptr, m_config.utc_offset_minutes );
+  curve_init();
+
+  /* Rendering happens on core1; start it off, and tell it what to show. */
+  render_init( l_unicorn, l_graphics );
+
+  /* The Unicorn resets the ADC as it starts, so only now set the light sensor up. */
+  light_init();
+  l_brightness = curve_level( light_level() );
+  render_post( &m_config, l_brightness, UC_SNAPSHOT_CONFIG );
+
+  /* Buttons interrupt us when pressed, rather than being constantly polled. */
+  for ( l_index = 0; l_index < UC_SWITCHES; l_index++ )
+  {
+    gpio_set_irq_enabled_with_callback( m_switches[l_index], GPIO_IRQ_EDGE_FALL, true, uniclock_button_cb );
+  }
+  m_idle_since = time_us_64();
 
   /* Now enter the main control loop; we normally never leave this. */
   while( true )
   {
     /* Handle any USB-facing work. */
+    UC_STATS_BEGIN( UC_STATS_USB );
     usb_update();
+    UC_STATS_END( UC_STATS_USB );
+
+#ifndef NDEBUG
+    /* Debug builds also respond to single character commands from the host. */
+    switch( usb_debug_getc() )
+    {
+      case 's':
+        /* Dump the timing statistics. */
+        stats_dump();
+        break;
+      case 'g':
+        /* Have core1 send out a set of golden frames, and then redraw properly. */
+        l_actions |= UC_SNAPSHOT_GOLDEN;
+        break;
+      case 't':
+        /* Have core1 check the rendering code. */
+        l_actions |= UC_SNAPSHOT_SELF_TEST;
+        break;
+    }
+#endif
 
     /* Other things we do less busily; configuration file changes. */
     if ( time_reached( l_config_check ) )
     {
       /* Check to see if the configuration file has been updated. */
+      UC_STATS_BEGIN( UC_STATS_CONFIG );
       if ( config_changed( m_config_stamp ) )
       {
         /* Then re-read it. */
@@ -88,19 +256,28 @@ int main()
 
         /* And apply any immediate changes. */
         time_set_utc_offset( nullptr, m_config.utc_offset_minutes );
+        l_actions |= UC_SNAPSHOT_CONFIG;
       }
+      UC_STATS_END( UC_STATS_CONFIG );
 
       /* Schedule the next check for a minutes time. */
       l_config_check = make_timeout_time_ms( UC_CONFIG_CHECK_MS );
     }
 
-    /* Adjust the brightness to reflect the ambient light levels. */
-    if ( time_reached( l_dimmer_check ) )
+    /*
+     * Adjust the brightness to reflect the ambient light levels. The ADC can't
+     * wake us when the light changes, so we look whenever we're awake anyway
+     * (at least once a second, for the RTC) and only wake just for this if
+     * nothing else has for a long while.
+     */
+    if ( time_reached( l_light_check ) )
     {
-      /* Fairly simple operation. */
-      display_update_brightness();
+      /* Filter the latest light samples; the display reacts to any change. */
+      light_update();
+      curve_update();
 
-      /* Schedule the next check for a minutes time. */
+      /* Don't filter more often than the samples can change, though. */
+      l_light_check = make_timeout_time_ms( UC_LIGHT_CHECK_MS );
       l_dimmer_check = make_timeout_time_ms( UC_DIMMER_MS );
     }
 
@@ -109,64 +286,117 @@ int main()
     {
       /* Ask for a time sync; we may need to call this repeatedly, to allow */
       /* for the wifi to become available.                                  */
+      UC_STATS_BEGIN( UC_STATS_NTP );
       if ( time_check_sync( &m_config ) )
       {
         /* Schedule the next check. */
         l_ntp_check = make_timeout_time_ms( UC_NTP_CHECK_MS );
       }
+      else
+      {
+        /* Still working on it, so come back shortly to see how it's going. */
+        l_ntp_check = make_timeout_time_ms( UC_NTP_POLL_MS );
+      }
+      UC_STATS_END( UC_STATS_NTP );
     }
 
-    /* Process any user input. */
-    if ( time_reached( l_input_delay ) )
+    /* Process any user input; when a button goes down, and while any are held. */
+    if ( ( m_button_pressed || l_buttons_held ) && time_reached( l_input_delay ) )
     {
+      m_button_pressed = false;
+
       /* First up, brightness controls, done on the LUX buttons. */
-      if ( l_unicorn->is_pressed( pimoroni::GalacticUnicorn::SWITCH_BRIGHTNESS_UP ) )
+      if ( l_unicorn->is_pressed( uc_unicorn_t::SWITCH_BRIGHTNESS_UP ) )
       {
-        display_brighter();
+        curve_adjust( light_level(), UC_CURVE_STEP );
+        l_actions |= UC_SNAPSHOT_BRIGHTNESS;
       }
-      if ( l_unicorn->is_pressed( pimoroni::GalacticUnicorn::SWITCH_BRIGHTNESS_DOWN ) )
+      if ( l_unicorn->is_pressed( uc_unicorn_t::SWITCH_BRIGHTNESS_DOWN ) )
       {
-        display_dimmer();
+        curve_adjust( light_level(), -UC_CURVE_STEP );
+        l_actions |= UC_SNAPSHOT_BRIGHTNESS;
       }
 
       /* Adjust the timezone using the volume buttons, like clock.py */
-      if ( l_unicorn->is_pressed( pimoroni::GalacticUnicorn::SWITCH_VOLUME_UP ) )
+      if ( l_unicorn->is_pressed( uc_unicorn_t::SWITCH_VOLUME_UP ) )
       {
         /* With this basic adjustment, offsets are locked to hour-long steps. */
         l_new_offset = ( ( time_get_utc_offset() / 60 ) + 1 ) * 60;
         time_set_utc_offset( &m_config, l_new_offset );
-        display_timezone();
+        l_actions |= UC_SNAPSHOT_TIMEZONE;
       }
-      if ( l_unicorn->is_pressed( pimoroni::GalacticUnicorn::SWITCH_VOLUME_DOWN ) )
+      if ( l_unicorn->is_pressed( uc_unicorn_t::SWITCH_VOLUME_DOWN ) )
       {
         /* With this basic adjustment, offsets are locked to hour-long steps. */
         l_new_offset = ( ( time_get_utc_offset() / 60 ) - 1 ) * 60;
         time_set_utc_offset( &m_config, l_new_offset );
-        display_timezone();
+        l_actions |= UC_SNAPSHOT_TIMEZONE;
       }
 
       /* Other displays; the 'D' button will briefly show you the date. */
-      if ( l_unicorn->is_pressed( pimoroni::GalacticUnicorn::SWITCH_D ) )
+      if ( l_unicorn->is_pressed( uc_unicorn_t::SWITCH_D ) )
+      {
+        l_actions |= UC_SNAPSHOT_DATE;
+      }
+
+      /* And the 'C' button cycles through the available clock faces. */
+      if ( l_unicorn->is_pressed( uc_unicorn_t::SWITCH_C ) )
       {
-        display_date();
+        display_next_face( &m_config );
+        l_actions |= UC_SNAPSHOT_FACE;
       }
 
-      /* Wait a little while until we check again. */
+      /* Wait a little while until we check again; we'll only poll while held. */
+      l_buttons_held = uniclock_buttons_held( l_unicorn );
       l_input_delay = make_timeout_time_ms( UC_INPUT_DELAY_MS );
     }
 
-    /* Rendering, which we do fairly leisurely. */
-    if ( time_reached( l_next_render ) )
+    /* Hand anything that's changed over to core1, to be rendered. */
+    l_level = curve_level( light_level() );
+    if ( ( l_actions != 0 ) || ( l_level != l_brightness ) )
+    {
+      render_post( &m_config, l_level, l_actions );
+      l_brightness = l_level;
+      l_actions = 0;
+    }
+    else
     {
-      /* Draw the display. */
-      display_render( &m_config );
+      render_flush();
+    }
 
-      /* Push the display out to the unicorn. */
-      l_unicorn->update( l_graphics );
+    /* Write out anything core1 wants reported, as it can't touch USB itself. */
+    render_report();
 
-      /* And schedule the next render. */
-      l_next_render = make_timeout_time_ms( UC_RENDER_MS );
+    /* Every so often, report on how much we're sleeping. */
+    if ( time_reached( l_stats_report ) )
+    {
+      uniclock_report_idle();
+      l_stats_report = make_timeout_time_ms( UC_STATS_MS );
+    }
+
+    /*
+     * And then sleep until the next thing is due; buttons, USB and the wifi
+     * all raise interrupts which wake us sooner, as does core1 making room
+     * in the queue or posting a report.
+     */
+    l_wake = l_config_check;
+    if ( absolute_time_diff_us( l_dimmer_check, l_wake ) > 0 )
+    {
+      l_wake = l_dimmer_check;
+    }
+    if ( absolute_time_diff_us( l_ntp_check, l_wake ) > 0 )
+    {
+      l_wake = l_ntp_check;
+    }
+    if ( absolute_time_diff_us( l_stats_report, l_wake ) > 0 )
+    {
+      l_wake = l_stats_report;
+    }
+    if ( ( m_button_pressed || l_buttons_held ) && ( absolute_time_diff_us( l_input_delay, l_wake ) > 0 ) )
+    {
+      l_wake = l_input_delay;
     }
+    uniclock_sleep_until( l_wake );
   }
 
   /* We would usually never expect to reach an end. */
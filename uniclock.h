@@ -14,23 +14,54 @@
 #pragma once
 
 #include "libraries/pico_graphics/pico_graphics.hpp"
+#if defined(UC_PANEL_COSMIC)
+#include "libraries/cosmic_unicorn/cosmic_unicorn.hpp"
+typedef pimoroni::CosmicUnicorn   uc_unicorn_t;
+#elif defined(UC_PANEL_STELLAR)
+#include "libraries/stellar_unicorn/stellar_unicorn.hpp"
+typedef pimoroni::StellarUnicorn  uc_unicorn_t;
+#else
 #include "libraries/galactic_unicorn/galactic_unicorn.hpp"
+typedef pimoroni::GalacticUnicorn uc_unicorn_t;
+#endif
 #include "lwip/dns.h"
 #include "lwip/udp.h"
 
 /* Constants. */
 
 #define UC_CONFIG_FILENAME    "config.txt"
+#define UC_CURVE_FILENAME     "curve.bin"
 #define UC_SSID_MAXLEN        32
 #define UC_PASSWORD_MAXLEN    64
 #define UC_NTPSERVER_MAXLEN   64
-#define UC_DATE_FORMAT_MAXLEN 4
+#define UC_DATE_FORMAT_MAXLEN 16
+#define UC_TIME_FORMAT_MAXLEN 16
+#define UC_FORMAT_MAXSTEPS    32
+#define UC_LANGUAGE_MAXLEN    4
+#define UC_TIMEZONE_MAXLEN    48
+#define UC_TEXT_MAXLEN        32
+#define UC_FACE_MAXLEN        16
+#define UC_LAYOUT_CACHE_SIZE  4
+#define UC_SNAPSHOT_QUEUE     4
 
 #define UC_CONFIG_CHECK_MS    5000
 #define UC_RENDER_MS          250
+#define UC_RENDER_IDLE_MS     1500
+#define UC_ANIMATE_FRAME_MS   16
+#define UC_ROLL_MS            300
+#define UC_MARQUEE_FRAME_MS   25
+#define UC_DATE_SHOW_MS       2500
+#define UC_TIMEZONE_SHOW_MS   1250
+#define UC_BRIGHTNESS_SHOW_MS 1250
+#define UC_BRIGHTNESS_ALPHA   255
+#define UC_FRAME_BUDGET_US    5000
+#define UC_FRAME_OVERRUNS     5
+#define UC_ANIMATE_BACKOFF_MS 60000
 #define UC_INPUT_DELAY_MS     250
 #define UC_DIMMER_MS          5000
 #define UC_NTP_CHECK_MS       60000
+#define UC_NTP_POLL_MS        50
+#define UC_STATS_MS           60000
 #define UC_NTP_REFRESH_MS     43200000L
 #define UC_NTP_EPOCH_OFFSET   2208988800L
 #define UC_NTP_PORT           123
@@ -46,17 +77,139 @@
 #define UC_VAL_MIDDAY         0.8f
 #define UC_VAL_MIDNIGHT       0.3f
 #define UC_HUE_OFFSET         -0.12f
+#define UC_GRADIENT_STEPS     256
+#ifdef UC_FRAMEBUFFER_P8
+#define UC_PEN_CACHE_BITS     8
+#define UC_PEN_CACHE_SIZE     ( 1 << UC_PEN_CACHE_BITS )
+#define UC_PEN_CACHE_PROBES   UC_PEN_CACHE_SIZE
+#else
+#define UC_PEN_CACHE_BITS     7
+#define UC_PEN_CACHE_SIZE     ( 1 << UC_PEN_CACHE_BITS )
+#define UC_PEN_CACHE_PROBES   4
+#endif
+#define UC_GRADIENT_PEN_BASE  192
+#define UC_ANGLE_STEPS        65536
+#define UC_ATLAS_GLYPHS       105
+#define UC_GLYPH_NONE         '\x01'
+#define UC_GLYPH_HEIGHT       8
+#define UC_GLYPH_INK_HEIGHT   7
+#define UC_PANEL_WIDTH        ( (int32_t)uc_unicorn_t::WIDTH )
+#define UC_PANEL_HEIGHT       ( (int32_t)uc_unicorn_t::HEIGHT )
+#define UC_FACE_COUNT         5
+#define UC_SECONDS_FRAME_MS   50
+#define UC_MARQUEE_MAXLEN     64
+#define UC_MARQUEE_MAXCOLS    ( UC_MARQUEE_MAXLEN * 6 )
+#define UC_MARQUEE_SUBSTEPS   8
+#define UC_MARQUEE_SPEED      20
+#define UC_BRIGHTNESS_LEVELS  256
+#define UC_BRIGHTNESS_FLOOR   96
+#define UC_DITHER_BITS        2
+#define UC_DITHER_LIMIT       64
+#define UC_DITHER_FRAME_MS    5
+#define UC_LIGHT_SAMPLES      64
+#define UC_LIGHT_SAMPLE_HZ    1000
+#define UC_LIGHT_START_MS     10
+#define UC_LIGHT_EMA_SHIFT    2
+#define UC_LIGHT_HYSTERESIS   32
+#define UC_LIGHT_CHECK_MS     50
+#define UC_RAMP_FRAME_MS      20
+#define UC_RAMP_SHIFT         2
+#define UC_LIGHT_LEVELS       4096
+#define UC_CURVE_POINTS       9
+#define UC_CURVE_SPACING      ( UC_LIGHT_LEVELS / ( UC_CURVE_POINTS - 1 ) )
+#define UC_CURVE_LUT_SIZE     64
+#define UC_CURVE_STEP         24
+#define UC_CURVE_SAVE_MS      30000
+#define UC_CURVE_MAGIC        0x56435543
+#define UC_CURVE_VERSION      1
 
 
+#define UC_STATS_BUCKETS      124
+#define UC_GOLDEN_STEP_MINS   30
+#define UC_GOLDEN_SCENES      8
+#define UC_BENCH_FRAMES       1000
+#define UC_BENCH_ROUNDS       10
+
+
+typedef enum
+{
+  UC_STATS_RENDER, UC_STATS_UPDATE, UC_STATS_USB, UC_STATS_CONFIG, 
+  UC_STATS_NTP, UC_STATS_LATENCY, UC_STATS_JITTER,
+  UC_STATS_STAGES
+} uc_stats_stage_t;
+
+typedef enum
+{
+  UC_TIMER_FACE, UC_TIMER_BRIGHTNESS,
+  UC_TIMERS
+} uc_timer_id_t;
+
+typedef enum
+{
+  UC_SNAPSHOT_CONFIG = 0x01, UC_SNAPSHOT_FACE = 0x02, UC_SNAPSHOT_BRIGHTNESS = 0x04,
+  UC_SNAPSHOT_TIMEZONE = 0x08, UC_SNAPSHOT_DATE = 0x10, UC_SNAPSHOT_GOLDEN = 0x20,
+  UC_SNAPSHOT_SELF_TEST = 0x40
+} uc_snapshot_action_t;
+
+typedef enum
+{
+  UC_LAYER_BRIGHTNESS,
+  UC_LAYERS
+} uc_layer_id_t;
+
 typedef enum
 {
-  UC_DISPLAY_TIME,
-  UC_DISPLAY_DATE, UC_DISPLAY_TIMEZONE
-} uc_display_mode_t;
+  UC_FORMAT_END, UC_FORMAT_LITERAL, UC_FORMAT_DAY, UC_FORMAT_MONTH, UC_FORMAT_YEAR,
+  UC_FORMAT_MONTH_NAME, UC_FORMAT_WEEKDAY_NAME, UC_FORMAT_HOUR24, UC_FORMAT_HOUR12,
+  UC_FORMAT_MINUTE, UC_FORMAT_SECOND, UC_FORMAT_AMPM
+} uc_format_op_t;
+
+
+/* The framebuffer holds palette entries, or RGB565, depending on the build. */
+
+#ifdef UC_FRAMEBUFFER_P8
+typedef uint8_t   uc_pixel_t;
+#else
+typedef uint16_t  uc_pixel_t;
+#endif
+
+
+/* Instrumentation, which only exists in debug builds. */
+
+#ifndef NDEBUG
+#define UC_STATS_BEGIN(s)     stats_begin( s )
+#define UC_STATS_END(s)       stats_end( s )
+#define UC_STATS_RECORD(s,t)  stats_record( s, t )
+#else
+#define UC_STATS_BEGIN(s)
+#define UC_STATS_END(s)
+#define UC_STATS_RECORD(s,t)
+#endif
+
+
+/* The layout of the display, worked out for whichever panel this is. */
+
+#include "panel.h"
 
 
 /* Structures. */
 
+typedef struct
+{
+  uint8_t op;
+  uint8_t value;
+  uint8_t width;
+} uc_format_step_t;
+
+typedef struct
+{
+  uc_format_step_t    steps[UC_FORMAT_MAXSTEPS];
+  const char * const *month_names;
+  const char * const *weekday_names;
+  uint8_t             month_widths[12];
+  uint8_t             weekday_widths[7];
+} uc_format_t;
+
 typedef struct
 {
   char    wifi_ssid[UC_SSID_MAXLEN+1];
@@ -64,8 +217,67 @@ typedef struct
   char    ntp_server[UC_NTPSERVER_MAXLEN+1];
   int16_t utc_offset_minutes;
   char    date_format[UC_DATE_FORMAT_MAXLEN+1];
+  char    time_format[UC_TIME_FORMAT_MAXLEN+1];
+  char    language[UC_LANGUAGE_MAXLEN+1];
+  char    timezone[UC_TIMEZONE_MAXLEN+1];
+  bool    animate;
+  char    face[UC_FACE_MAXLEN+1];
+  uc_format_t date_program;
+  uc_format_t time_program;
 } uc_config_t;
 
+typedef struct
+{
+  const char   *name;
+  uint32_t      frame_ms;
+  void        (*enter)( void );
+  void        (*render)( const uc_config_t *, const datetime_t * );
+  bool        (*tick)( void );
+  void        (*exit)( void );
+} uc_face_t;
+
+typedef struct
+{
+  char          text[UC_TEXT_MAXLEN+1];
+  uint32_t      hash;
+  uint_fast16_t width;
+  int32_t       x;
+} uc_layout_t;
+
+typedef struct
+{
+  absolute_time_t deadline;
+  uc_timer_id_t   id;
+} uc_timer_t;
+
+typedef struct
+{
+  int32_t   x, y, width, height;
+} uc_rect_t;
+
+typedef struct
+{
+  uc_pixel_t  pixels[UC_PANEL_WIDTH*UC_PANEL_HEIGHT];
+  uc_rect_t   bounds, drawn;
+  uint8_t     alpha;
+  bool        changed;
+} uc_layer_t;
+
+typedef struct
+{
+  uc_config_t   config;
+  uint8_t       brightness;
+  uint8_t       actions;
+} uc_snapshot_t;
+
+typedef struct
+{
+  uint32_t      frames_rendered, frames_pushed;
+  uint32_t      total_pixels;
+  uint32_t      worst_frame_us;
+  uint32_t      pen_hits, pen_misses;
+} uc_display_stats_t;
+
 typedef struct
 {
   ip_addr_t       server;
@@ -80,19 +292,62 @@ uint32_t  config_read( uc_config_t * );
 bool      config_write( const uc_config_t * );
 bool      config_changed( uint32_t );
 
-void      display_init( pimoroni::GalacticUnicorn *, pimoroni::PicoGraphics * );
-void      display_render( const uc_config_t * );
-void      display_update_brightness( void );
-void      display_dimmer( void );
-void      display_brighter( void );
+void      display_init( uc_unicorn_t *, pimoroni::PicoGraphics * );
+bool      display_render( const uc_config_t * );
+void      display_push( void );
+void      display_set_brightness( uint8_t );
+void      display_show_brightness( void );
 void      display_timezone( void );
 void      display_date( void );
+void      display_take_stats( uc_display_stats_t * );
+void      display_report_stats( const uc_display_stats_t * );
+uint32_t  display_frame_ms( void );
+absolute_time_t display_next_deadline( void );
+bool      display_frame_time( uint32_t );
+void      display_golden_frames( const uc_config_t * );
+bool      display_self_test( const uc_config_t * );
+void      display_set_face( const char *, bool );
+void      display_next_face( uc_config_t * );
+int       display_intern_pen( uint8_t, uint8_t, uint8_t );
+void      display_fill_rect( int, int32_t, int32_t, int32_t, int32_t );
+void      display_draw_pixel( int, int32_t, int32_t );
+uint_fast8_t display_glyph_width( char );
+void      display_blit_scaled_glyph( char, int32_t, int32_t, uint_fast8_t, uint_fast8_t, int, int );
+
+extern const uc_face_t  uc_face_large, uc_face_binary, uc_face_progress, uc_face_seconds;
+
+void      format_compile( const char *, char, const char *, uc_format_t * );
+uint_fast8_t format_render( const uc_format_t *, const datetime_t *, char *, uint_fast8_t, uint_fast16_t * );
+
+void      curve_init( void );
+uint8_t   curve_level( uint16_t );
+void      curve_adjust( uint16_t, int );
+void      curve_update( void );
+
+void      light_init( void );
+void      light_update( void );
+uint16_t  light_level( void );
+
+void      render_init( uc_unicorn_t *, pimoroni::PicoGraphics * );
+void      render_post( const uc_config_t *, uint8_t, uint8_t );
+void      render_flush( void );
+void      render_report( void );
+
+void      stats_init( void );
+void      stats_begin( uc_stats_stage_t );
+void      stats_end( uc_stats_stage_t );
+void      stats_record( uc_stats_stage_t, uint32_t );
+void      stats_dump( void );
 
 void      time_init( void );
 bool      time_check_sync( const uc_config_t * );
 void      time_set_timezone( const char * );
 void      time_set_utc_offset( uc_config_t *, int16_t );
 int16_t   time_get_utc_offset( void );
+bool      time_second_elapsed( void );
+uint32_t  time_subsecond_us( void );
+void      time_get_datetime( datetime_t * );
+void      time_override( const datetime_t * );
 
 
 /* End of file uniclock.h */
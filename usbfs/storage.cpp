@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "pico/multicore.h"
 #include "hardware/flash.h"
 #include "hardware/sync.h"
 
@@ -71,13 +72,23 @@ int32_t storage_read( uint32_t p_sector, uint32_t p_offset,
 
 
 /*
- * write - stores data into flash, with appropriate guards. 
+ * write - stores data into flash, with appropriate guards; the other core
+ *         can't be left running from flash while we write to it, so if it
+ *         is set up to be locked out, it is. Writes only come from core0.
  */
 
 int32_t storage_write( uint32_t p_sector, uint32_t p_offset,
                        const uint8_t *p_buffer, uint32_t p_size_bytes )
 {
   uint32_t l_status;
+  bool     l_lockout;
+
+  /* Park the other core, if it's running. */
+  l_lockout = multicore_lockout_victim_is_initialized( 1 );
+  if ( l_lockout )
+  {
+    multicore_lockout_start_blocking();
+  }
 
   /* Don't want to be interrupted. */
   l_status = save_and_disable_interrupts();
@@ -94,8 +105,12 @@ int32_t storage_write( uint32_t p_sector, uint32_t p_offset,
     p_buffer, p_size_bytes
   );
 
-  /* Lastly, restore our interrupts. */
+  /* Lastly, restore our interrupts, and let the other core go again. */
   restore_interrupts( l_status );
+  if ( l_lockout )
+  {
+    multicore_lockout_end_blocking();
+  }
 
   /* Before returning the amount of data written. */
   return p_size_bytes;
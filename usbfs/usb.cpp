@@ -18,6 +18,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+
 /* Local headers. */
 
 #include "tusb.h"
@@ -28,6 +31,7 @@
 
 static bool     m_mounted = true;
 static bool     m_fs_changed = false;
+static recursive_mutex_t  m_usb_mutex;
 
 
 /* Functions.*/
@@ -128,7 +132,46 @@ bool tud_msc_is_writable_cb( uint8_t p_lun )
 
 
 /*
- * Higher level USB functions; these are the ones exposed to our program.
+ * cdc_write - writes a block of data to the CDC channel, waiting until it has
+ *             all gone. Only core0 runs tinyusb; the other core can write to
+ *             it, but has to leave core0 to make room when it fills up.
+ */
+
+static void usb_cdc_write( const uint8_t *p_data, uint32_t p_length )
+{
+  uint32_t  l_sentbytes;
+
+  /* Keep writing until it's all gone, or there's nobody listening. */
+  recursive_mutex_enter_blocking( &m_usb_mutex );
+  l_sentbytes = tud_cdc_write( p_data, p_length );
+  while ( l_sentbytes < p_length )
+  {
+    if ( get_core_num() == 0 )
+    {
+      tud_task();
+    }
+    else
+    {
+      recursive_mutex_exit( &m_usb_mutex );
+      sleep_us( 100 );
+      recursive_mutex_enter_blocking( &m_usb_mutex );
+    }
+    if ( !tud_ready() )
+    {
+      break;
+    }
+    l_sentbytes += tud_cdc_write( p_data + l_sentbytes, p_length - l_sentbytes );
+  }
+  recursive_mutex_exit( &m_usb_mutex );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * Higher level USB functions; these are the ones exposed to our program. Both
+ * cores may send debug output, so tinyusb is only ever used under our mutex.
  */
 
 /*
@@ -137,7 +180,8 @@ bool tud_msc_is_writable_cb( uint8_t p_lun )
 
 void usb_init( void )
 {
-  /* Initialise the tinyusb library. */
+  /* Initialise the tinyusb library, and the mutex that guards it. */
+  recursive_mutex_init( &m_usb_mutex );
   tusb_init();
 
   /* All done. */
@@ -151,7 +195,9 @@ void usb_init( void )
 void usb_update( void )
 {
   /* Ask tinyusb to run any device tasks. */
+  recursive_mutex_enter_blocking( &m_usb_mutex );
   tud_task();
+  recursive_mutex_exit( &m_usb_mutex );
 
   /* All done. */
   return;
@@ -159,40 +205,77 @@ void usb_update( void )
 
 
 /*
- * debug - sends a debug message over CDC; we treat this channel as write-only.
+ * debug - sends a debug message over CDC; this channel is mostly write-only,
+ *         with just the odd single character command coming the other way.
  */
 
 void usb_debug( const char *p_message, ... )
 {
   va_list   l_args;
-  char      l_buffer[64];
+  char      l_buffer[USB_DEBUG_MAXLEN+4];
   int       l_msglen;
-  uint32_t  l_sentbytes;
 
   /* Assemble the debug message. */
   va_start( l_args, p_message );
-  l_msglen = vsnprintf( l_buffer, 60, p_message, l_args );
-  strcat( l_buffer, "\r\n" );
-  l_msglen += 2;
+  l_msglen = vsnprintf( l_buffer, USB_DEBUG_MAXLEN, p_message, l_args );
   va_end( l_args );
 
-  /* And send it to USB. */
-  l_sentbytes = tud_cdc_write( l_buffer, l_msglen );
-  while ( l_sentbytes < l_msglen )
+  /* Anything too long has been cut short, so only send what we have. */
+  if ( l_msglen < 0 )
   {
-    tud_task();
-    if ( !tud_ready() )
-    {
-      break;
-    }
-    l_sentbytes += tud_cdc_write( l_buffer + l_sentbytes, l_msglen - l_sentbytes );
+    l_msglen = 0;
+    l_buffer[0] = '\0';
+  }
+  if ( l_msglen > USB_DEBUG_MAXLEN - 1 )
+  {
+    l_msglen = USB_DEBUG_MAXLEN - 1;
   }
+  strcat( l_buffer, "\r\n" );
+  l_msglen += 2;
+
+  /* And send it to USB. */
+  usb_cdc_write( (const uint8_t *)l_buffer, l_msglen );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * debug_write - sends a block of raw data over CDC; this is for the occasional
+ *               binary dump, rather than for general messages.
+ */
+
+void usb_debug_write( const void *p_data, uint32_t p_length )
+{
+  /* Much like usb_debug, keep writing until it's all gone. */
+  usb_cdc_write( (const uint8_t *)p_data, p_length );
 
   /* All done. */
   return;
 }
 
 
+/*
+ * debug_getc - fetches a single character sent to us over CDC, or -1 if 
+ *              nothing is waiting.
+ */
+
+int usb_debug_getc( void )
+{
+  int l_char = -1;
+
+  /* Only try to read if there's something there. */
+  recursive_mutex_enter_blocking( &m_usb_mutex );
+  if ( tud_cdc_available() > 0 )
+  {
+    l_char = tud_cdc_read_char();
+  }
+  recursive_mutex_exit( &m_usb_mutex );
+  return l_char;
+}
+
+
 /*
  * fs_changed - set a flag that tinyusb can use to inform the host that data
  *              on the filesystem has changed locally.
@@ -26,6 +26,8 @@
 
 #define UFS_LABEL           "GUnicorn"
 
+#define USB_DEBUG_MAXLEN    60
+
 
 /* Function prototypes. */
 
@@ -40,6 +42,8 @@ FRESULT   ufs_unmount( void );
 void      usb_init( void );
 void      usb_update( void );
 void      usb_debug( const char *, ... );
+void      usb_debug_write( const void *, uint32_t );
+int       usb_debug_getc( void );
 void      usb_fs_changed( void );
 
 